@@ -1,21 +1,26 @@
 // Dependencies
 import * as Path from "https://deno.land/std/path/mod.ts";
-import { LexerGrammar } from "./src/types.ts";
+import { LexerGrammar, Runtime } from "./src/types.ts";
 
 // Custom Modules
 import formatArgs, { Args } from "./src/mods/args.ts";
 import { readFile, writeFile, resolve } from "./src/mods/fs.ts";
+import BuildCache from "./src/mods/cache.ts";
+import { BuildFailure, prebuildRuntime } from "./src/mods/runtime.ts";
+import { buildProgram, compiler, compilerFlags, execute, profileTypes } from "./src/mods/driver.ts";
 
-import { ADKFileNotFound } from "./src/errors.ts";
+import { ADKBuildError, ADKFileNotFound } from "./src/errors.ts";
 import Lexer from "./src/lexer.ts";
 import Parser from "./src/parser.ts";
+import Optimizer from "./src/optimizer.ts";
 import Transpiler from "./src/transpiler.ts";
 
 // Other Stuff
-async function runFile(args: Args, fileName: string) {
+async function transpileFile(args: Args, fileName: string, runtime?: Runtime, types?: { probe?: boolean, profile?: Map<string, number> }): Promise<string> {
   const debug: number = parseInt(args.getArg("--debug") || "0");
   const resolvedFile: string = Path.resolve(fileName);
   const fileNoExt = fileName.replace(/\.[a-zA-Z]*$/, "");
+  const output = Path.resolve(`./${fileNoExt}.cpp`);
 
   // console.log(fileName, resolvedFile);
 
@@ -40,18 +45,35 @@ async function runFile(args: Args, fileName: string) {
       "\\"
     ],
 
-    Keywords: ["True", "False", "funct", "if", "while", "return"],
-    Operators: ["=", "==", "!=", "+=", "<", ">", "<=", ">="],
+    Keywords: ["True", "False", "funct", "if", "else", "while", "for", "in", "return"],
+    Operators: ["=", "==", "!=", "+=", "-=", "*=", "%=", "++", "--", "<", ">", "<=", ">="],
     BinOperators: ["*", "/", "%", "+", "-"],
 
     Datatypes: [],
-    Delimiters: ["(", ")", "{", "}", ",", ".", ":", ";"],
+    Delimiters: ["(", ")", "{", "}", "[", "]", ",", ".", ":", ";"],
 
     Digits: "0123456789",
     Strings: ["\"", "\'"],
     Special: ["$", "#", "_"]
   };
 
+  // Unchanged programs reuse the C++ from their last build, debugging always rebuilds
+  const cache = args.hasArg("--no-cache") || debug > 0 ? undefined : new BuildCache();
+  const key = await cache?.key([
+    input, JSON.stringify(grammar), Deno.cwd(), args.hasArg("--no-optimize") ? "no-optimize" : "",
+    runtime?.library ?? "", types?.probe ? "probe" : "", JSON.stringify([...types?.profile ?? []])
+  ]);
+
+  if (cache && key) {
+    const cached = await cache.lookup(key);
+
+    if (cached !== undefined) {
+      // Left untouched when it's already current, so its timestamp doesn't trigger a recompile
+      if (await readFile(output) !== cached) await writeFile(output, cached);
+      return output;
+    }
+  }
+
   const lexer = new Lexer(input, resolvedFile, grammar);
   const tokens = lexer.tokenize();
 
@@ -67,32 +89,87 @@ async function runFile(args: Args, fileName: string) {
 
   const ast = parser.parse();
 
+  if (!args.hasArg("--no-optimize"))
+    new Optimizer().optimize(ast);
+
   if (debug > 1)
     console.log(ast.block);
 
   const transpiler = new Transpiler(parser);
-  await transpiler.defineLibs(["./src/builtIns/langCPP.cpp", "./src/builtIns/stdio.cpp"]);
+  transpiler.probeTypes = types?.probe ?? false;
+  transpiler.typeProfile = types?.profile ?? new Map;
+
+  if (runtime)
+    transpiler.includeRuntime(runtime);
+  else
+    await transpiler.defineLibs(["./src/builtIns/langCPP.cpp", "./src/builtIns/stdio.hpp", "./src/builtIns/stdio.cpp"]);
 
   const code = transpiler.transpile();
 
   if (debug > 2)
     console.log(code);
 
-  await writeFile(Path.resolve(`./${fileNoExt}.cpp`), code);
+  await writeFile(output, code);
+  if (cache && key) await cache.store(key, code, parser.included);
+
+  return output;
 }
 
+// Transpiles against the runtime prebuilt for the profile's flags and
+// compiles, reusing the cached binary when nothing changed
+async function buildFile(args: Args, fileName: string): Promise<string> {
+  const cache = new BuildCache();
+  const runtime = await prebuildRuntime(cache.dir, compiler(), compilerFlags(args));
 
-// Main Function
-function main(argc: number, argv: string[]) {
-  const args = formatArgs(argv);
+  // pgo starts with a run of a probed build, so Dynamic arguments that
+  // always held one type can be specialised before the C++ profile is taken
+  let profile: Map<string, number> | undefined;
+
+  if (args.getArg("--profile") == "pgo" && !args.hasArg("--no-type-profile"))
+    profile = await profileTypes(args, await transpileFile(args, fileName, runtime, { probe: true }), runtime, cache);
 
-  if (args.hasArg("run")) {
-    const fileName = args.getArg(args.indexOf("run") + 1)
-    runFile(args, fileName);
+  const source = await transpileFile(args, fileName, runtime, { profile });
+
+  return buildProgram(args, source, runtime, cache);
+}
+
+
+// Main Function
+// transpile only writes <file>.cpp, build also compiles it to <file>
+// (or --output=<path>) and run compiles and executes it. Arguments after
+// -- are the program's own.
+async function main(argc: number, argv: string[]) {
+  const separator = argv.indexOf("--");
+  const programArgs = separator == -1 ? [] : argv.slice(separator + 1);
+  const args = formatArgs(separator == -1 ? argv : argv.slice(0, separator));
+
+  if (args.hasArg("transpile")) {
+    const fileName = args.getArg(args.indexOf("transpile") + 1);
+
+    // --prebuilt-runtime includes the runtime built once for these compiler
+    // flags instead of pasting it into every program
+    const runtime = args.hasArg("--prebuilt-runtime")
+      ? await prebuildRuntime(new BuildCache().dir, compiler(), compilerFlags(args))
+      : undefined;
+
+    await transpileFile(args, fileName, runtime);
+  } else if (args.hasArg("build")) {
+    const fileName = args.getArg(args.indexOf("build") + 1);
+    const output = args.getArg("--output") || fileName.replace(/\.[a-zA-Z]*$/, "");
+
+    await Deno.copyFile(await buildFile(args, fileName), output);
+  } else if (args.hasArg("run")) {
+    const fileName = args.getArg(args.indexOf("run") + 1);
+
+    Deno.exit(await execute(await buildFile(args, fileName), programArgs));
   }
 }
 
 // Bootstrapping
 if (import.meta.main) {
-  main(Deno.args.length, [...Deno.args]);
+  // Build steps clean up after themselves before a failure gets here
+  main(Deno.args.length, [...Deno.args]).catch((error) => {
+    if (error instanceof BuildFailure) new ADKBuildError(error.message);
+    throw error;
+  });
 }
\ No newline at end of file
@@ -1,739 +1,3249 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
-class Dynamic
-{
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Any integer type except bool, which Dynamic keeps as BOOL
+template<typename T, typename R = void>
+using IfInteger = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, R>;
+
+// Integers and floating point, again without bool
+template<typename T, typename R = void>
+using IfNumber = std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, R>;
+
+// Stream Reader //
+// Reads a file descriptor in large blocks into one reusable buffer that
+// is scanned in place, for stdin as well as streamed files.
+
+class StreamReader {
   public:
 
-  // File Type //
+  int fd;
+  bool owned;
+  void (*beforeRead)();
 
-  class ADKFile {
-    public:
+  std::vector<char> data = std::vector<char>(1 << 16);
+  size_t start = 0;
+  size_t end = 0;
+  bool eof = false;
 
-    std::string filename;
+  StreamReader(int fd, bool owned = true, void (*beforeRead)() = nullptr)
+    : fd(fd), owned(owned), beforeRead(beforeRead)
+  {};
 
-    ADKFile() {};
-    ADKFile(const char* str)
-      : filename(std::string(str))
-    {};
+  explicit StreamReader(const std::string& filename)
+    : StreamReader(::open(filename.c_str(), O_RDONLY))
+  {
+    if (fd < 0)
+      throw "Cannot open file for reading";
 
-    ADKFile(std::string str)
-      : filename(str)
-    {};
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  };
 
-    std::string read() {
-      std::string line;
-      std::string text = "";
-      std::ifstream ReadFile(filename);
+  StreamReader(const StreamReader&) = delete;
+  StreamReader& operator= (const StreamReader&) = delete;
 
-      while (std::getline(ReadFile, line)) {
-        text += line + "\n";
-      };
+  ~StreamReader() {
+    if (owned && fd >= 0)
+      ::close(fd);
+  }
 
-      ReadFile.close();
+  // Keeps the unread bytes, moved to the front, and reads more after them.
+  // The buffer only grows when a single token or line doesn't fit.
+  bool fill() {
+    if (eof)
+      return false;
 
-      return text;
+    if (beforeRead)
+      beforeRead();
+
+    if (start > 0) {
+      memmove(data.data(), data.data() + start, end - start);
+      end -= start;
+      start = 0;
     }
 
-    template<typename T>
-    void append(T str) {
-      std::ofstream WriteFile;
-      WriteFile.open(filename, std::ios::out | std::ios::app);
-      WriteFile << str;
+    if (end == data.size())
+      data.resize(data.size() * 2);
 
-      WriteFile.close();
+    ssize_t count;
+
+    do {
+      count = ::read(fd, data.data() + end, data.size() - end);
+    } while (count < 0 && errno == EINTR);
+
+    if (count <= 0) {
+      eof = true;
+      return false;
     }
 
-    template<typename T>
-    void write(T str) {
-      std::ofstream WriteFile(filename);
-      WriteFile << str;
+    end += count;
+    return true;
+  }
 
-      WriteFile.close();
+  bool available() {
+    return start < end || fill();
+  }
+
+  // False once only whitespace is left
+  bool skipSpace() {
+    while (true) {
+      while (start < end && isspace((unsigned char)data[start]))
+        start++;
+
+      if (start < end)
+        return true;
+      else if (!fill())
+        return false;
     }
-  };
+  }
 
-  // Other Types //
+  // Views below point into the buffer and are only valid until the next read
 
-  enum TYPES {
-    STRING,
-    INT,
-    DOUBLE,
-    BOOL,
-    FILE
-  } type;
+  std::string_view token() {
+    if (!skipSpace())
+      return {};
 
-  std::string str;
-  int num;
-  double flt;
-  bool bln;
+    size_t length = 0;
 
-  Dynamic(const Dynamic& x) {
-    type = x.type;
-    str = x.str;
-    num = x.num;
-    bln = x.bln;
-    flt = x.flt;
-  };
-  Dynamic(const char* x) {
-    type = STRING;
-    str = x;
-  };
-  Dynamic(std::string x) {
-    type = STRING;
+    while (true) {
+      while (start + length < end && !isspace((unsigned char)data[start + length]))
+        length++;
+
+      if (start + length < end || !fill())
+        break;
+    }
 
-    str = x;
+    std::string_view text(data.data() + start, length);
+    start += length;
+
+    return text;
   }
-  Dynamic(int x) {
-    type = INT;
 
-    num = x;
-  };
-  Dynamic(double x) {
-    type = DOUBLE;
+  // Next line without its line ending, false once the input is exhausted
+  bool line(std::string_view& text) {
+    size_t length = 0;
+    bool newline = false;
 
-    flt = x;
-  };
-  Dynamic(bool x) {
-    type = BOOL;
+    while (true) {
+      const char* found = (const char*)memchr(data.data() + start + length, '\n', end - start - length);
 
-    bln = x;
-  };
-  Dynamic() {
-    type = BOOL;
+      if (found) {
+        length = found - (data.data() + start);
+        newline = true;
+        break;
+      }
 
-    bln = 0;
+      length = end - start;
+
+      if (!fill()) {
+        if (length == 0)
+          return false;
+
+        break;
+      }
+    }
+
+    text = std::string_view(data.data() + start, length);
+    start += length + newline;
+
+    if (!text.empty() && text.back() == '\r')
+      text.remove_suffix(1);
+
+    return true;
   }
 
-  // Assignment Operators //
+  // Next `size` bytes, or whatever is left at the end of the stream
+  bool chunk(std::string_view& text, size_t size) {
+    while (end - start < size && fill());
 
-  std::string operator= (std::string x) {
-    type = STRING;
+    size_t length = std::min(size, end - start);
 
-    str = x;
-    return str;
-  };
+    if (length == 0)
+      return false;
 
-  int operator= (int x) {
-    type = INT;
+    text = std::string_view(data.data() + start, length);
+    start += length;
 
-    num = x;
-    return num;
-  };
+    return true;
+  }
 
-  double operator= (double x) {
-    type = DOUBLE;
+  std::string_view all() {
+    while (fill());
 
-    flt = x;
-    return flt;
-  };
+    std::string_view text(data.data() + start, end - start);
+    start = end;
 
-  bool operator= (bool x) {
-    type = BOOL;
+    return text;
+  }
+};
 
-    bln = x;
-    return bln;
+// Write Behind //
+// Opt-in background thread for file writes. Buffers handed to it are
+// written in submission order, consecutive ones for the same file in a
+// single writev, while the program keeps computing.
+
+class AsyncWriter {
+  public:
+
+  static constexpr size_t MAX_PARTS = 1024;
+
+  // fd < 0 replaces the whole file at filename instead (newFile)
+  struct Job {
+    int fd;
+    std::string filename;
+    std::string data;
   };
 
-  Dynamic operator+ (int x) {
-    if (type == INT) {
-      return Dynamic(num + x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt + (double)x);
-    } else if (type == STRING) {
-      return Dynamic(str + std::to_string(x));
-    }
-    
-    return (*this);
+  bool enabled = false;
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable done;
+
+  std::vector<Job> queue;
+  size_t submitted = 0;
+  size_t completed = 0;
+  bool failed = false;
+  bool stopping = false;
+
+  std::thread worker;
+
+  static AsyncWriter& instance() {
+    static AsyncWriter writer;
+    return writer;
   }
-  Dynamic operator+ (double x) {
-    if (type == INT) {
-      return Dynamic(num + (int)x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt + x);
-    } else if (type == STRING) {
-      return Dynamic(str + std::to_string(x));
+
+  ~AsyncWriter() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
     }
-    
-    return (*this);
+
+    ready.notify_one();
+
+    if (worker.joinable())
+      worker.join();
   }
-  Dynamic operator+ (const char* x) {
-    if (type == STRING) {
-      return Dynamic(str + x);
+
+  void submit(Job job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (!worker.joinable())
+        worker = std::thread(&AsyncWriter::run, this);
+
+      queue.push_back(std::move(job));
+      submitted++;
     }
-    
-    return (*this);
+
+    ready.notify_one();
   }
-  Dynamic operator+ (std::string x) {
-    if (type == STRING) {
-      return Dynamic(str + x);
-    } else if (type == INT) {
-      return Dynamic(std::to_string(num) + x);
-    } else if (type == DOUBLE) {
-      return Dynamic(std::to_string(flt) + x);
-    } else if (type == BOOL) {
-      return Dynamic((bln ? "True" : "False") + x);
+
+  // Blocks until everything submitted so far is written, false if any of it failed
+  bool wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return completed == submitted; });
+
+    bool written = !failed;
+    failed = false;
+
+    return written;
+  }
+
+  static bool writeAll(int fd, std::vector<iovec>& parts) {
+    size_t index = 0;
+
+    while (index < parts.size()) {
+      ssize_t count = writev(fd, &parts[index], std::min(parts.size() - index, MAX_PARTS));
+
+      if (count < 0 && errno == EINTR)
+        continue;
+      else if (count <= 0)
+        return false;
+
+      // Skip what was written, a part may only be written partially
+      while (count > 0) {
+        if ((size_t)count >= parts[index].iov_len) {
+          count -= parts[index].iov_len;
+          index++;
+        } else {
+          parts[index].iov_base = (char*)parts[index].iov_base + count;
+          parts[index].iov_len -= count;
+          count = 0;
+        }
+      }
     }
-    
-    return (*this);
+
+    return true;
   }
-  Dynamic operator+ (Dynamic x) {
-    if (type == INT) {
-      if (x.type == DOUBLE)
-        return num + (int)flt;
 
-      return Dynamic(num + x.num);
-    } else if (type == DOUBLE) {
-      if (x.type == INT)
-        return flt + (double)x.num;
+  bool perform(std::vector<Job>& batch, size_t first, size_t last) {
+    std::vector<iovec> parts;
 
-      return Dynamic(flt + x.flt);
-    } else if (type == STRING) {
-      if (type == INT)
-        return Dynamic(str + std::to_string(x.num));
-      else if (type == DOUBLE)
-        return Dynamic(str + std::to_string(x.flt));
-      
-      return Dynamic(str + x.str);
+    // Empty jobs are left out, writev returning 0 for them isn't a failure
+    for (size_t i = first; i < last; i++) {
+      if (!batch[i].data.empty())
+        parts.push_back({ (void*)batch[i].data.data(), batch[i].data.size() });
     }
-    
-    return (*this);
+
+    if (batch[first].fd >= 0)
+      return writeAll(batch[first].fd, parts);
+
+    int fd = ::open(batch[first].filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+      return false;
+
+    bool written = writeAll(fd, parts);
+    return (::close(fd) == 0) && written;
   }
 
-  Dynamic operator- (int x) {
-    if (type == INT) {
-      return Dynamic(num - x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt - (double)x);
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+      ready.wait(lock, [&] { return stopping || !queue.empty(); });
+
+      if (queue.empty())
+        return;
+
+      std::vector<Job> batch;
+      batch.swap(queue);
+      lock.unlock();
+
+      bool written = true;
+
+      for (size_t first = 0, last; first < batch.size(); first = last) {
+        last = first + 1;
+
+        if (batch[first].fd >= 0) {
+          while (last < batch.size() && batch[last].fd == batch[first].fd)
+            last++;
+        }
+
+        written = perform(batch, first, last) && written;
+      }
+
+      lock.lock();
+      failed = failed || !written;
+      completed += batch.size();
+      done.notify_all();
     }
-    
+  }
+};
+
+// Interned Strings //
+// One immortal copy of each interned text, with its hash computed once.
+// Two interned values hold the same text exactly when they hold the same
+// pointer, so comparing or hashing them never reads the characters.
+// Only literals from the program are interned, strings built at runtime
+// aren't, so the table can't grow without bound.
+
+class InternedString {
+  public:
+
+  std::string text;
+  size_t hash;
+
+  static const InternedString* get(std::string_view text) {
+    // Never destroyed, interned constants can outlive any static
+    static std::mutex mutex;
+    static auto* table = new std::unordered_map<std::string_view, const InternedString*>();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto found = table->find(text);
+    if (found != table->end())
+      return found->second;
+
+    InternedString* entry = new InternedString{ std::string(text), std::hash<std::string_view>{}(text) };
+    table->emplace(entry->text, entry);
+
+    return entry;
+  }
+};
+
+class Dynamic;
+
+// Numeric Arrays //
+// Packed int64 or double storage for numeric code. The kernels are plain
+// loops over contiguous memory so the compiler can vectorise them, and
+// reductions keep four partial results instead of one serial chain.
+// Like lists, arrays are shared by reference; arithmetic makes new ones.
+
+class NumericArray {
+  public:
+
+  struct Data {
+    size_t references = 1;
+    bool isDouble = false;
+    std::vector<long long> ints;
+    std::vector<double> doubles;
+  };
+
+  Data* data;
+
+  explicit NumericArray(size_t size = 0, bool isDouble = false)
+    : data(new Data())
+  {
+    data->isDouble = isDouble;
+
+    if (isDouble)
+      data->doubles.resize(size);
+    else
+      data->ints.resize(size);
+  }
+
+  explicit NumericArray(Data* shared)
+    : data(shared)
+  {
+    data->references++;
+  }
+
+  NumericArray(const NumericArray& x)
+    : data(x.data)
+  {
+    data->references++;
+  }
+
+  NumericArray(NumericArray&& x) noexcept
+    : data(x.data)
+  {
+    x.data = nullptr;
+  }
+
+  NumericArray& operator= (NumericArray x) noexcept {
+    std::swap(data, x.data);
     return (*this);
   }
-  Dynamic operator- (double x) {
-    if (type == INT) {
-      return Dynamic(num - (int)x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt - x);
+
+  ~NumericArray() {
+    if (data && --data->references == 0)
+      delete data;
+  }
+
+  size_t size() const {
+    return data->isDouble ? data->doubles.size() : data->ints.size();
+  }
+
+  bool isDouble() const {
+    return data->isDouble;
+  }
+
+  // Converted to doubles, for mixing with a double operand
+  std::vector<double> asDoubles() const {
+    if (data->isDouble)
+      return data->doubles;
+
+    return std::vector<double>(data->ints.begin(), data->ints.end());
+  }
+
+  // The doubles themselves, or a converted copy kept in scratch
+  const double* doublesOf(std::vector<double>& scratch) const {
+    if (data->isDouble)
+      return data->doubles.data();
+
+    scratch.assign(data->ints.begin(), data->ints.end());
+    return scratch.data();
+  }
+
+  size_t position(long long index) const {
+    long long length = size();
+    long long at = index < 0 ? index + length : index;
+
+    if (at < 0 || at >= length)
+      throw "Array index out of range";
+
+    return at;
+  }
+
+  // Defined after Dynamic
+  Dynamic get(const Dynamic& index) const;
+  void set(const Dynamic& index, const Dynamic& value);
+  void push(const Dynamic& value);
+
+  Dynamic sum() const;
+  Dynamic min() const;
+  Dynamic max() const;
+  Dynamic dot(const NumericArray& x) const;
+
+  std::string toString() const;
+
+  // Kernels //
+
+  // out[i] = a[i] op b[i], b advancing by step (0 for a scalar). The body
+  // is unrolled by four so even -O2, which won't vectorise a loop of
+  // unknown length, packs each group into vector instructions. out is
+  // always a fresh array, so it can't overlap a or b.
+  template<typename Out, typename T, typename Op>
+  static void zip(Out* __restrict out, const T* a, const T* b, size_t step, size_t size, Op op) {
+    size_t i = 0;
+
+    if (step == 0) {
+      T right = *b;
+
+      for (; i + 4 <= size; i += 4) {
+        out[i] = op(a[i], right);
+        out[i + 1] = op(a[i + 1], right);
+        out[i + 2] = op(a[i + 2], right);
+        out[i + 3] = op(a[i + 3], right);
+      }
+
+      for (; i < size; i++)
+        out[i] = op(a[i], right);
+    } else {
+      for (; i + 4 <= size; i += 4) {
+        out[i] = op(a[i], b[i]);
+        out[i + 1] = op(a[i + 1], b[i + 1]);
+        out[i + 2] = op(a[i + 2], b[i + 2]);
+        out[i + 3] = op(a[i + 3], b[i + 3]);
+      }
+
+      for (; i < size; i++)
+        out[i] = op(a[i], b[i]);
     }
-    
-    return (*this);
   }
-  Dynamic operator- (Dynamic x) {
-    if (type == INT) {
-      if (x.type == DOUBLE)
-        return num - (int)flt;
 
-      return Dynamic(num - x.num);
-    } else if (type == DOUBLE) {
-      if (x.type == INT)
-        return flt - (double)x.num;
+  // Additions and subtractions wrap and fold a sign-bit overflow flag, so
+  // the loop stays branch free; multiplications and divisions are checked
+  // one by one.
+  static void intKernel(char op, long long* out, const long long* a, const long long* b, size_t step, size_t size) {
+    unsigned long long overflow = 0;
+
+    if (op == '+') {
+      zip(out, a, b, step, size, [&](long long x, long long y) {
+        long long result = (long long)((unsigned long long)x + (unsigned long long)y);
+        overflow |= (unsigned long long)((x ^ result) & (y ^ result));
+        return result;
+      });
+    } else if (op == '-') {
+      zip(out, a, b, step, size, [&](long long x, long long y) {
+        long long result = (long long)((unsigned long long)x - (unsigned long long)y);
+        overflow |= (unsigned long long)((x ^ y) & (x ^ result));
+        return result;
+      });
+    } else if (op == '*') {
+      zip(out, a, b, step, size, [&](long long x, long long y) {
+        long long result;
+        overflow |= (unsigned long long)__builtin_mul_overflow(x, y, &result) << 63;
+        return result;
+      });
+    } else {
+      zip(out, a, b, step, size, [&](long long x, long long y) {
+        if (y == 0)
+          throw "Cannot divide by zero";
 
-      return Dynamic(flt - x.flt);
+        if (x == LLONG_MIN && y == -1) {
+          overflow = 1ULL << 63;
+          return x;
+        }
+
+        return x / y;
+      });
     }
-    
-    return (*this);
+
+    if (overflow >> 63)
+      throw std::overflow_error("Integer overflow in array arithmetic");
   }
-  
-  friend Dynamic operator- (int x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x - y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x - (int)y.flt);
+
+  static void doubleKernel(char op, double* out, const double* a, const double* b, size_t step, size_t size) {
+    if (op == '+')
+      zip(out, a, b, step, size, [](double x, double y) { return x + y; });
+    else if (op == '-')
+      zip(out, a, b, step, size, [](double x, double y) { return x - y; });
+    else if (op == '*')
+      zip(out, a, b, step, size, [](double x, double y) { return x * y; });
+    else
+      zip(out, a, b, step, size, [](double x, double y) { return x / y; });
+  }
+
+  // 1 where the comparison holds, 0 where it doesn't
+  template<typename T>
+  static void compareKernel(const std::string& op, long long* out, const T* a, const T* b, size_t step, size_t size) {
+    if (op == "==")
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x == y; });
+    else if (op == "!=")
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x != y; });
+    else if (op == "<")
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x < y; });
+    else if (op == ">")
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x > y; });
+    else if (op == "<=")
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x <= y; });
+    else
+      zip(out, a, b, step, size, [](T x, T y) -> long long { return x >= y; });
+  }
+
+  template<typename T>
+  static double sumDoubles(const T* a, size_t size) {
+    double parts[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+
+    for (; i + 4 <= size; i += 4) {
+      parts[0] += a[i];
+      parts[1] += a[i + 1];
+      parts[2] += a[i + 2];
+      parts[3] += a[i + 3];
     }
 
-    return Dynamic(x);
+    for (; i < size; i++)
+      parts[0] += a[i];
+
+    return (parts[0] + parts[1]) + (parts[2] + parts[3]);
   }
-  friend Dynamic operator- (double x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x - (double)y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x - y.flt);
+
+  static double dotDoubles(const double* a, const double* b, size_t size) {
+    double parts[4] = { 0, 0, 0, 0 };
+    size_t i = 0;
+
+    for (; i + 4 <= size; i += 4) {
+      parts[0] += a[i] * b[i];
+      parts[1] += a[i + 1] * b[i + 1];
+      parts[2] += a[i + 2] * b[i + 2];
+      parts[3] += a[i + 3] * b[i + 3];
     }
 
-    return Dynamic(x);
+    for (; i < size; i++)
+      parts[0] += a[i] * b[i];
+
+    return (parts[0] + parts[1]) + (parts[2] + parts[3]);
   }
 
-  Dynamic operator* (int x) {
-    if (type == INT) {
-      return Dynamic(num * x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt * (double)x);
+  // False when the sum doesn't fit in 64 bits
+  static bool sumInts(const long long* a, size_t size, long long& total) {
+    unsigned long long result = 0;
+    unsigned long long overflow = 0;
+
+    for (size_t i = 0; i < size; i++) {
+      unsigned long long next = result + (unsigned long long)a[i];
+      overflow |= ((long long)result ^ (long long)next) & (a[i] ^ (long long)next);
+      result = next;
     }
-    
-    return (*this);
+
+    total = (long long)result;
+    return !(overflow >> 63);
   }
-  Dynamic operator* (double x) {
-    if (type == INT) {
-      return Dynamic(num * (int)x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt * x);
+
+  static bool dotInts(const long long* a, const long long* b, size_t size, long long& total) {
+    long long result = 0;
+
+    for (size_t i = 0; i < size; i++) {
+      long long product;
+
+      if (__builtin_mul_overflow(a[i], b[i], &product) || __builtin_add_overflow(result, product, &result))
+        return false;
     }
-    
-    return (*this);
+
+    total = result;
+    return true;
   }
-  Dynamic operator* (Dynamic x) {
-    if (type == INT) {
-      if (x.type == DOUBLE)
-        return num * (int)flt;
 
-      return Dynamic(num * x.num);
-    } else if (type == DOUBLE) {
-      if (x.type == INT)
-        return flt * (double)x.num;
+  template<typename T, typename Pick>
+  static T reduce(const T* a, size_t size, Pick pick) {
+    T result = a[0];
+
+    for (size_t i = 1; i < size; i++)
+      result = pick(result, a[i]);
+
+    return result;
+  }
+
+  // Operators //
+  // An int array only stays int against ints, a double anywhere makes
+  // the result a double array
+
+  static NumericArray arithmetic(char op, const NumericArray& a, const NumericArray& b) {
+    if (a.size() != b.size())
+      throw "Arrays must be the same size";
+
+    return a.apply(op, b.data->isDouble, b.data->ints.data(), b.data->doubles.data(), 1, b);
+  }
+
+  template<typename T>
+  NumericArray scalar(char op, T x, bool reversed) const {
+    NumericArray other(1, std::is_floating_point_v<T>);
+
+    if constexpr (std::is_floating_point_v<T>)
+      other.data->doubles[0] = x;
+    else
+      other.data->ints[0] = x;
+
+    if (!reversed)
+      return apply(op, other.isDouble(), other.data->ints.data(), other.data->doubles.data(), 0, other);
+
+    // x op array, the scalar is broadcast to the array's size first
+    NumericArray left(size(), other.isDouble());
+
+    if (other.isDouble())
+      std::fill(left.data->doubles.begin(), left.data->doubles.end(), other.data->doubles[0]);
+    else
+      std::fill(left.data->ints.begin(), left.data->ints.end(), other.data->ints[0]);
+
+    return arithmetic(op, left, *this);
+  }
+
+  NumericArray apply(char op, bool otherDouble, const long long* ints, const double* doubles, size_t step, const NumericArray& other) const {
+    size_t length = size();
+
+    if (!data->isDouble && !otherDouble) {
+      NumericArray result(length, false);
+      intKernel(op, result.data->ints.data(), data->ints.data(), ints, step, length);
+      return result;
+    }
+
+    NumericArray result(length, true);
+    std::vector<double> left, right;
+
+    doubleKernel(op, result.data->doubles.data(), doublesOf(left), otherDouble ? doubles : other.doublesOf(right), step, length);
+    return result;
+  }
+
+  static NumericArray comparison(const std::string& op, const NumericArray& a, const NumericArray& b, size_t step) {
+    if (step != 0 && a.size() != b.size())
+      throw "Arrays must be the same size";
+
+    NumericArray result(a.size(), false);
+
+    if (!a.isDouble() && !b.isDouble()) {
+      compareKernel(op, result.data->ints.data(), a.data->ints.data(), b.data->ints.data(), step, a.size());
+    } else {
+      std::vector<double> left, right;
+      compareKernel(op, result.data->ints.data(), a.doublesOf(left), b.doublesOf(right), step, a.size());
+    }
+
+    return result;
+  }
+
+  template<typename T>
+  static NumericArray single(T x) {
+    NumericArray result(1, std::is_floating_point_v<T>);
+
+    if constexpr (std::is_floating_point_v<T>)
+      result.data->doubles[0] = x;
+    else
+      result.data->ints[0] = x;
+
+    return result;
+  }
+
+  NumericArray operator+ (const NumericArray& x) const { return arithmetic('+', *this, x); }
+  NumericArray operator- (const NumericArray& x) const { return arithmetic('-', *this, x); }
+  NumericArray operator* (const NumericArray& x) const { return arithmetic('*', *this, x); }
+  NumericArray operator/ (const NumericArray& x) const { return arithmetic('/', *this, x); }
+
+  template<typename T>
+  IfNumber<T, NumericArray> operator+ (T x) const { return scalar('+', x, false); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator- (T x) const { return scalar('-', x, false); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator* (T x) const { return scalar('*', x, false); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator/ (T x) const { return scalar('/', x, false); }
+
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator+ (T x, const NumericArray& y) { return y.scalar('+', x, true); }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator- (T x, const NumericArray& y) { return y.scalar('-', x, true); }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator* (T x, const NumericArray& y) { return y.scalar('*', x, true); }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator/ (T x, const NumericArray& y) { return y.scalar('/', x, true); }
+
+  // Elementwise comparisons give an int array of 1s and 0s
+  NumericArray operator== (const NumericArray& x) const { return comparison("==", *this, x, 1); }
+  NumericArray operator!= (const NumericArray& x) const { return comparison("!=", *this, x, 1); }
+  NumericArray operator< (const NumericArray& x) const { return comparison("<", *this, x, 1); }
+  NumericArray operator> (const NumericArray& x) const { return comparison(">", *this, x, 1); }
+  NumericArray operator<= (const NumericArray& x) const { return comparison("<=", *this, x, 1); }
+  NumericArray operator>= (const NumericArray& x) const { return comparison(">=", *this, x, 1); }
+
+  template<typename T>
+  IfNumber<T, NumericArray> operator== (T x) const { return comparison("==", *this, single(x), 0); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator!= (T x) const { return comparison("!=", *this, single(x), 0); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator< (T x) const { return comparison("<", *this, single(x), 0); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator> (T x) const { return comparison(">", *this, single(x), 0); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator<= (T x) const { return comparison("<=", *this, single(x), 0); }
+  template<typename T>
+  IfNumber<T, NumericArray> operator>= (T x) const { return comparison(">=", *this, single(x), 0); }
+
+  // x op array is array flipped-op x
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator== (T x, const NumericArray& y) { return y == x; }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator!= (T x, const NumericArray& y) { return y != x; }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator< (T x, const NumericArray& y) { return y > x; }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator> (T x, const NumericArray& y) { return y < x; }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator<= (T x, const NumericArray& y) { return y >= x; }
+  template<typename T>
+  friend IfNumber<T, NumericArray> operator>= (T x, const NumericArray& y) { return y <= x; }
+};
+
+class DynamicList;
+class DynamicMap;
+
+class Dynamic
+{
+  public:
+
+  // File Type //
+
+  class ADKFile {
+    public:
+
+    std::string filename;
+
+    ADKFile() {};
+    ADKFile(const char* str)
+      : filename(std::string(str))
+    {};
+
+    ADKFile(std::string str)
+      : filename(str)
+    {};
+
+    // Read-only view of the whole file, shared by every copy of the handle
+    class Mapping {
+      public:
+
+      const char* data = nullptr;
+      size_t size = 0;
+      bool mapped = false;
+      std::string fallback; // used when the file can't be mapped
+
+      ~Mapping() {
+        if (mapped)
+          munmap((void*)data, size);
+      }
+    };
+
+    std::shared_ptr<Mapping> mapping;
+
+    // Sized with one fstat and filled with a single read where possible
+    std::string read() {
+      wait();
+
+      std::string text;
+      int fd = ::open(filename.c_str(), O_RDONLY);
+
+      if (fd < 0)
+        return text;
+
+      struct stat info;
+      size_t size = 0;
+
+      // A regular file goes straight into a buffer allocated once, with
+      // room for the \n that may be added below
+      if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        text.reserve(info.st_size + 1);
+        text.resize(info.st_size);
+
+        while (size < text.size()) {
+          ssize_t count = ::read(fd, &text[size], text.size() - size);
+
+          if (count < 0 && errno == EINTR)
+            continue;
+          else if (count <= 0)
+            break;
+
+          size += count;
+        }
+      }
+
+      // Confirms EOF with a small read. Pipes, and a file that grew since
+      // the fstat, are read on in chunks.
+      char chunk[1 << 14];
+
+      while (true) {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+
+        if (count < 0 && errno == EINTR)
+          continue;
+        else if (count <= 0)
+          break;
+
+        text.resize(size);
+        text.append(chunk, count);
+        size += count;
+      }
+
+      ::close(fd);
+      text.resize(size);
+
+      // Same result as the old line by line read, every line ends in \n
+      if (!text.empty() && text.back() != '\n')
+        text += '\n';
+
+      return text;
+    }
+
+    // Zero-copy read, valid until the file is written to or closed
+    std::string_view map() {
+      wait();
+
+      if (!mapping) {
+        mapping = std::make_shared<Mapping>();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        struct stat info;
+
+        if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+          void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+          if (data != MAP_FAILED) {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+
+            mapping->data = (const char*)data;
+            mapping->size = info.st_size;
+            mapping->mapped = true;
+          }
+        }
+
+        if (fd >= 0)
+          ::close(fd);
+
+        if (!mapping->mapped) {
+          mapping->fallback = read();
+          mapping->data = mapping->fallback.data();
+          mapping->size = mapping->fallback.size();
+        }
+      }
+
+      return std::string_view(mapping->data, mapping->size);
+    }
+
+    // Range-for over the lines (chunkSize 0) or fixed-size chunks of a
+    // file. Each step reuses the same string, so memory stays constant
+    // however large the file is.
+    class Stream {
+      public:
+
+      class iterator {
+        public:
+
+        Stream* stream;
+
+        const std::string& operator* () const {
+          return stream->current;
+        }
+
+        iterator& operator++ () {
+          stream->next();
+          return (*this);
+        }
+
+        bool operator!= (const iterator&) const {
+          return !stream->done;
+        }
+      };
+
+      StreamReader reader;
+      size_t chunkSize;
+
+      std::string current;
+      bool done = false;
+
+      Stream(const std::string& filename, size_t chunkSize)
+        : reader(filename), chunkSize(chunkSize)
+      {};
+
+      void next() {
+        std::string_view text;
+
+        done = chunkSize > 0
+          ? !reader.chunk(text, chunkSize)
+          : !reader.line(text);
+
+        if (!done)
+          current.assign(text.data(), text.size());
+      }
+
+      iterator begin() {
+        next();
+        return { this };
+      }
+
+      iterator end() {
+        return { this };
+      }
+    };
+
+    Stream lines() {
+      wait();
+
+      return Stream(filename, 0);
+    }
+
+    Stream chunks(size_t size) {
+      if (size == 0)
+        throw "Chunk size must be positive";
+
+      wait();
+
+      return Stream(filename, size);
+    }
+
+    // Write side, shared by every handle to the same path and kept open
+    // between calls. Appends are collected in a buffer and written in large
+    // blocks, so reading through any handle flushes the path's one buffer.
+    class Writer {
+      public:
+
+      static const size_t CAPACITY = 1 << 16;
+
+      int fd = -1;
+      std::string buffer;
+
+      // The path's writer while any handle holds it, made when create is set
+      static std::shared_ptr<Writer> forPath(const std::string& filename, bool create) {
+        static std::mutex mutex;
+        static auto* writers = new std::unordered_map<std::string, std::weak_ptr<Writer>>();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto found = writers->find(filename);
+        std::shared_ptr<Writer> writer = found == writers->end() ? nullptr : found->second.lock();
+
+        if (writer || !create) {
+          if (!writer && found != writers->end())
+            writers->erase(found);
+
+          return writer;
+        }
+
+        writer = std::make_shared<Writer>();
+        (*writers)[filename] = writer;
+
+        return writer;
+      }
+
+      ~Writer() {
+        close();
+      }
+
+      bool flush() {
+        AsyncWriter& async = AsyncWriter::instance();
+
+        if (async.enabled) {
+          if (!buffer.empty())
+            async.submit({ fd, "", std::move(buffer) });
+
+          buffer = std::string();
+          return true;
+        }
+
+        size_t done = 0;
+
+        while (done < buffer.size()) {
+          ssize_t count = ::write(fd, buffer.data() + done, buffer.size() - done);
+
+          if (count < 0 && errno == EINTR)
+            continue;
+          else if (count <= 0)
+            break;
+
+          done += count;
+        }
+
+        bool written = done == buffer.size();
+        buffer.clear();
+
+        return written;
+      }
+
+      void close() {
+        if (fd < 0)
+          return;
+
+        flush();
+        AsyncWriter::instance().wait();
+
+        ::close(fd);
+        fd = -1;
+      }
+    };
+
+    std::shared_ptr<Writer> writer;
+
+    // Opened on first use, and again after a close()
+    Writer& handle() {
+      if (!writer)
+        writer = Writer::forPath(filename, true);
+
+      if (writer->fd < 0)
+        writer->fd = ::open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+
+      if (writer->fd < 0)
+        throw "Cannot open file for writing";
+
+      return *writer;
+    }
+
+    // Anything that isn't text is formatted the way an ofstream always did
+    template<typename T>
+    void format(Writer& out, const T& value) {
+      std::ostringstream stream;
+      stream << value;
+
+      out.buffer.append(stream.str());
+    }
+
+    template<typename T>
+    void put(Writer& out, const T& str) {
+      if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        out.buffer.append(std::string_view(str));
+      } else if constexpr (std::is_same_v<T, Dynamic>) {
+        if (str.type == STRING)
+          out.buffer.append(str.view());
+        else
+          format(out, str);
+      } else {
+        format(out, str);
+      }
+
+      if (out.buffer.size() >= Writer::CAPACITY && !out.flush())
+        throw "Cannot write to file";
+    }
+
+    template<typename T>
+    void append(const T& str) {
+      mapping.reset();
+
+      put(handle(), str);
+    }
+
+    // Replaces the contents, anything still buffered would be overwritten anyway
+    template<typename T>
+    void write(const T& str) {
+      mapping.reset();
+
+      Writer& out = handle();
+      out.buffer.clear();
+
+      // Queued writes have to land before the file is emptied
+      if (!AsyncWriter::instance().wait())
+        throw "Cannot write to file";
+
+      if (ftruncate(out.fd, 0) != 0)
+        throw "Cannot write to file";
+
+      put(out, str);
+    }
+
+    // Another handle to the path may have appended through the shared writer
+    void flush() {
+      if (!writer)
+        writer = Writer::forPath(filename, false);
+
+      if (writer && writer->fd >= 0 && !writer->flush())
+        throw "Cannot write to file";
+    }
+
+    // Like flush(), but in async mode also blocks until the data is written
+    void wait() {
+      flush();
+
+      if (!AsyncWriter::instance().wait())
+        throw "Cannot write to file";
+    }
+
+    void close() {
+      flush();
+
+      if (writer)
+        writer->close();
+
+      mapping.reset();
+    }
+  };
+
+  // Integer Type //
+
+  // Arbitrary-precision integer, only used once 64-bit INT math overflows
+  class BigInt {
+    public:
+
+    static const uint32_t BASE = 1000000000;
+
+    bool negative = false;
+    std::vector<uint32_t> limbs; // base 1e9, least significant first
+
+    BigInt() {};
+    BigInt(long long x) {
+      negative = x < 0;
+      unsigned long long magnitude = negative
+        ? 0ULL - (unsigned long long)x
+        : (unsigned long long)x;
+
+      while (magnitude > 0) {
+        limbs.push_back(magnitude % BASE);
+        magnitude /= BASE;
+      }
+    };
+
+    bool isZero() const {
+      return limbs.empty();
+    }
+
+    void trim() {
+      while (!limbs.empty() && limbs.back() == 0)
+        limbs.pop_back();
+
+      if (limbs.empty())
+        negative = false;
+    }
+
+    static int compareMagnitude(const BigInt& a, const BigInt& b) {
+      if (a.limbs.size() != b.limbs.size())
+        return a.limbs.size() < b.limbs.size() ? -1 : 1;
+
+      for (size_t i = a.limbs.size(); i-- > 0;) {
+        if (a.limbs[i] != b.limbs[i])
+          return a.limbs[i] < b.limbs[i] ? -1 : 1;
+      }
+
+      return 0;
+    }
+
+    int compare(const BigInt& x) const {
+      if (negative != x.negative)
+        return negative ? -1 : 1;
+
+      int result = compareMagnitude(*this, x);
+      return negative ? -result : result;
+    }
+
+    static BigInt addMagnitude(const BigInt& a, const BigInt& b) {
+      BigInt result;
+      uint64_t carry = 0;
+
+      for (size_t i = 0; i < std::max(a.limbs.size(), b.limbs.size()) || carry; i++) {
+        uint64_t sum = carry
+          + (i < a.limbs.size() ? a.limbs[i] : 0)
+          + (i < b.limbs.size() ? b.limbs[i] : 0);
+
+        result.limbs.push_back(sum % BASE);
+        carry = sum / BASE;
+      }
+
+      return result;
+    }
+
+    // Expects |a| >= |b|
+    static BigInt subMagnitude(const BigInt& a, const BigInt& b) {
+      BigInt result;
+      int64_t borrow = 0;
+
+      for (size_t i = 0; i < a.limbs.size(); i++) {
+        int64_t diff = (int64_t)a.limbs[i] - borrow - (i < b.limbs.size() ? b.limbs[i] : 0);
+
+        borrow = diff < 0;
+        result.limbs.push_back(diff + (borrow ? BASE : 0));
+      }
+
+      result.trim();
+      return result;
+    }
+
+    BigInt operator- () const {
+      BigInt result = (*this);
+
+      if (!result.isZero())
+        result.negative = !negative;
+
+      return result;
+    }
+
+    BigInt operator+ (const BigInt& x) const {
+      BigInt result;
+
+      if (negative == x.negative) {
+        result = addMagnitude(*this, x);
+        result.negative = negative;
+      } else if (compareMagnitude(*this, x) >= 0) {
+        result = subMagnitude(*this, x);
+        result.negative = negative;
+      } else {
+        result = subMagnitude(x, *this);
+        result.negative = x.negative;
+      }
+
+      result.trim();
+      return result;
+    }
+
+    BigInt operator- (const BigInt& x) const {
+      return (*this) + (-x);
+    }
+
+    BigInt operator* (const BigInt& x) const {
+      BigInt result;
+      result.limbs.assign(limbs.size() + x.limbs.size(), 0);
+
+      for (size_t i = 0; i < limbs.size(); i++) {
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j < x.limbs.size() || carry; j++) {
+          uint64_t current = result.limbs[i + j] + carry
+            + (j < x.limbs.size() ? (uint64_t)limbs[i] * x.limbs[j] : 0);
+
+          result.limbs[i + j] = current % BASE;
+          carry = current / BASE;
+        }
+      }
+
+      result.negative = negative != x.negative;
+      result.trim();
+      return result;
+    }
+
+    // Truncates toward zero like C++ integer division
+    BigInt operator/ (const BigInt& x) const {
+      if (x.isZero())
+        throw "Cannot divide by zero";
+
+      BigInt result;
+      BigInt remainder;
+      BigInt divisor = x;
+
+      divisor.negative = false;
+      result.limbs.assign(limbs.size(), 0);
+
+      for (size_t i = limbs.size(); i-- > 0;) {
+        remainder.limbs.insert(remainder.limbs.begin(), limbs[i]);
+        remainder.trim();
+
+        uint32_t low = 0;
+        uint32_t high = BASE - 1;
+
+        while (low < high) {
+          uint32_t mid = low + (high - low + 1) / 2;
+
+          if (compareMagnitude(divisor * BigInt(mid), remainder) <= 0)
+            low = mid;
+          else
+            high = mid - 1;
+        }
+
+        result.limbs[i] = low;
+        remainder = subMagnitude(remainder, divisor * BigInt(low));
+      }
+
+      result.negative = negative != x.negative;
+      result.trim();
+      return result;
+    }
+
+    bool fitsInt() const {
+      return compare(BigInt(LLONG_MIN)) >= 0 && compare(BigInt(LLONG_MAX)) <= 0;
+    }
+
+    long long toInt() const {
+      unsigned long long magnitude = 0;
+
+      for (size_t i = limbs.size(); i-- > 0;)
+        magnitude = magnitude * BASE + limbs[i];
+
+      return negative ? (long long)(0ULL - magnitude) : (long long)magnitude;
+    }
+
+    double toDouble() const {
+      double result = 0;
+
+      for (size_t i = limbs.size(); i-- > 0;)
+        result = result * BASE + limbs[i];
+
+      return negative ? -result : result;
+    }
+
+    std::string toString() const {
+      if (isZero())
+        return "0";
+
+      std::string text = negative ? "-" : "";
+      text += std::to_string(limbs.back());
+
+      for (size_t i = limbs.size() - 1; i-- > 0;) {
+        std::string part = std::to_string(limbs[i]);
+        text.append(9 - part.size(), '0').append(part);
+      }
+
+      return text;
+    }
+
+    // Expects an optional '-' followed by digits only
+    static BigInt parse(std::string_view text) {
+      BigInt result;
+      bool negative = !text.empty() && text[0] == '-';
+
+      if (negative)
+        text.remove_prefix(1);
+
+      for (size_t end = text.size(); end > 0; end = end > 9 ? end - 9 : 0) {
+        uint32_t limb = 0;
+
+        for (size_t i = end > 9 ? end - 9 : 0; i < end; i++)
+          limb = limb * 10 + (text[i] - '0');
+
+        result.limbs.push_back(limb);
+      }
+
+      result.trim();
+      result.negative = negative && !result.isZero();
+      return result;
+    }
+  };
+
+  // Other Types //
+
+  enum TYPES : unsigned char {
+    STRING,
+    INT,
+    DOUBLE,
+    BOOL,
+    FILE,
+    BIGINT,
+    LIST,
+    MAP,
+    ARRAY
+  };
+
+  // Storage //
+  // Numbers, booleans and short strings live inline, anything larger
+  // (long strings, files, big integers, collections) is kept out-of-line
+  // behind a pointer so an INT Dynamic stays 16 bytes and copying it never
+  // allocates. An interned STRING points at its shared InternedString.
+
+  static const int SMALL_CAPACITY = 7;
+
+  union {
+    long long num;
+    double flt;
+    bool bln;
+    char small[SMALL_CAPACITY + 1];
+    std::string* heap;
+    const InternedString* symbol;
+    ADKFile* adkfile;
+    BigInt* big;
+    DynamicList* list;
+    DynamicMap* dict;
+    NumericArray::Data* packed;
+  };
+
+  unsigned char smallSize;
+  bool onHeap;
+  bool interned;
+  TYPES type;
+
+  Dynamic(const Dynamic& x) {
+    type = BOOL;
+    copyFrom(x);
+  };
+  Dynamic(Dynamic&& x) noexcept {
+    type = BOOL;
+    moveFrom(x);
+  };
+  Dynamic(const char* x) {
+    type = BOOL;
+    setString(std::string_view(x));
+  };
+  Dynamic(std::string x) {
+    type = BOOL;
+
+    setString(std::move(x));
+  }
+  template<typename T, typename = IfInteger<T>>
+  Dynamic(T x) {
+    type = INT;
+
+    num = x;
+  };
+  Dynamic(BigInt x) {
+    type = BOOL;
+
+    setInteger(std::move(x));
+  };
+  Dynamic(double x) {
+    type = DOUBLE;
+
+    flt = x;
+  };
+  Dynamic(bool x) {
+    type = BOOL;
+
+    bln = x;
+  };
+  Dynamic(const NumericArray& x) {
+    type = ARRAY;
+
+    packed = x.data;
+    packed->references++;
+  }
+  Dynamic() {
+    type = BOOL;
+
+    bln = 0;
+  }
+
+  ~Dynamic() {
+    release();
+  }
+
+  // Storage Helpers //
+
+  void release() {
+    if (type == STRING && onHeap) {
+      delete heap;
+    } else if (type == FILE) {
+      delete adkfile;
+    } else if (type == BIGINT) {
+      delete big;
+    } else if (type == LIST || type == MAP || type == ARRAY) {
+      releaseCollection();
+    }
+
+    type = BOOL;
+    bln = 0;
+  }
+
+  void setString(std::string_view x) {
+    release();
+    type = STRING;
+
+    interned = false;
+
+    if (x.size() <= SMALL_CAPACITY) {
+      onHeap = false;
+      smallSize = x.size();
+      x.copy(small, x.size());
+      small[x.size()] = '\0';
+    } else {
+      onHeap = true;
+      heap = new std::string(x);
+    }
+  }
+
+  void setString(std::string&& x) {
+    if (x.size() <= SMALL_CAPACITY) {
+      setString(std::string_view(x));
+      return;
+    }
+
+    release();
+    type = STRING;
+    onHeap = true;
+    interned = false;
+    heap = new std::string(std::move(x));
+  }
+
+  // Shares the one copy of x, see InternedString
+  static Dynamic intern(std::string_view x) {
+    Dynamic result;
+
+    result.type = STRING;
+    result.onHeap = false;
+    result.interned = true;
+    result.symbol = InternedString::get(x);
+
+    return result;
+  }
+
+  // Steals the out-of-line storage of x and leaves it as False. x is
+  // emptied before anything is released, as it may live inside a
+  // collection this value is about to let go of.
+  void moveFrom(Dynamic& x) {
+    char storage[sizeof(small)];
+    std::memcpy(storage, x.small, sizeof(small));
+
+    TYPES movedType = x.type;
+    bool movedOnHeap = false;
+    bool movedInterned = false;
+    unsigned char movedSize = 0;
+
+    if (movedType == STRING) {
+      movedOnHeap = x.onHeap;
+      movedInterned = x.interned;
+      movedSize = x.smallSize;
+    }
+
+    x.type = BOOL;
+    x.bln = 0;
+
+    release();
+
+    if (movedType == STRING) {
+      onHeap = movedOnHeap;
+      interned = movedInterned;
+      smallSize = movedSize;
+    }
+
+    std::memcpy(small, storage, sizeof(small));
+    type = movedType;
+  }
+
+  // Keeps results that fit in 64 bits on the INT fast path
+  void setInteger(BigInt x) {
+    release();
+
+    if (x.fitsInt()) {
+      type = INT;
+      num = x.toInt();
+    } else {
+      type = BIGINT;
+      big = new BigInt(std::move(x));
+    }
+  }
+
+  void copyFrom(const Dynamic& x) {
+    // x may be an element of the collection being replaced
+    if (type == LIST || type == MAP) {
+      Dynamic copy(x);
+      moveFrom(copy);
+      return;
+    }
+
+    if (x.type == STRING && !x.interned) {
+      setString(x.view());
+      return;
+    }
+
+    release();
+
+    if (x.type == INT) {
+      num = x.num;
+    } else if (x.type == DOUBLE) {
+      flt = x.flt;
+    } else if (x.type == BOOL) {
+      bln = x.bln;
+    } else if (x.type == STRING) {
+      onHeap = false;
+      interned = true;
+      symbol = x.symbol;
+    } else if (x.type == FILE) {
+      adkfile = new ADKFile(*x.adkfile);
+    } else if (x.type == BIGINT) {
+      big = new BigInt(*x.big);
+    } else if (x.type == LIST || x.type == MAP || x.type == ARRAY) {
+      shareCollection(x);
+    }
+
+    type = x.type;
+  }
+
+  std::string_view view() const {
+    if (type != STRING)
+      return std::string_view();
+
+    if (interned)
+      return symbol->text;
+
+    return onHeap
+      ? std::string_view(*heap)
+      : std::string_view(small, smallSize);
+  }
+
+  // Reuses the heap buffer when there is one, for values reassigned in a loop
+  void assignString(std::string_view x) {
+    if (type == STRING && onHeap && x.size() > SMALL_CAPACITY)
+      heap->assign(x);
+    else
+      setString(x);
+  }
+
+  void appendString(std::string_view x) {
+    if (type == STRING && onHeap) {
+      heap->append(x);
+      return;
+    }
+
+    std::string text;
+    text.reserve(view().size() + x.size());
+    text.append(view()).append(x);
+    setString(std::move(text));
+  }
+
+  // Builds a STRING from two pieces with a single allocation at most
+  static Dynamic concat(std::string_view left, std::string_view right) {
+    std::string text;
+    text.reserve(left.size() + right.size());
+    text.append(left).append(right);
+
+    return Dynamic(std::move(text));
+  }
+
+  // The text a value contributes when concatenated onto a string
+  std::string concatText() const {
+    if (type == INT)
+      return std::to_string(num);
+    else if (type == DOUBLE)
+      return std::to_string(flt);
+    else if (type == BIGINT)
+      return big->toString();
+    else if (type == LIST || type == MAP || type == ARRAY)
+      return formatCollection();
+
+    return std::string(view());
+  }
+
+  // Truthiness, for `if` and `while` on a Dynamic: False, zero, empty
+  // strings and empty collections are false
+  explicit operator bool() const {
+    if (type == BOOL)
+      return bln;
+    else if (type == INT)
+      return num != 0;
+    else if (type == DOUBLE)
+      return flt != 0;
+    else if (type == BIGINT)
+      return !big->isZero();
+    else if (type == STRING || type == LIST || type == MAP || type == ARRAY)
+      return size() > 0;
+
+    throw "Cannot use this type as a condition";
+  }
+
+  // Numeric Helpers //
+
+  bool isNumber() const {
+    return type == INT || type == DOUBLE || type == BIGINT;
+  }
+
+  double toDouble() const {
+    if (type == INT)
+      return (double)num;
+    else if (type == BIGINT)
+      return big->toDouble();
+
+    return flt;
+  }
+
+  BigInt toBig() const {
+    if (type == BIGINT)
+      return *big;
+    else if (type == DOUBLE)
+      return BigInt((long long)flt);
+
+    return BigInt(num);
+  }
+
+  static Dynamic bigOp(char op, const BigInt& a, const BigInt& b) {
+    if (op == '+')
+      return Dynamic(a + b);
+    else if (op == '-')
+      return Dynamic(a - b);
+    else if (op == '*')
+      return Dynamic(a * b);
+
+    return Dynamic(a / b);
+  }
+
+  // 64-bit fast path, checked with the compiler builtins
+  static Dynamic intOp(char op, long long a, long long b) {
+    long long result = 0;
+    bool overflow = false;
+
+    if (op == '+') {
+      overflow = __builtin_add_overflow(a, b, &result);
+    } else if (op == '-') {
+      overflow = __builtin_sub_overflow(a, b, &result);
+    } else if (op == '*') {
+      overflow = __builtin_mul_overflow(a, b, &result);
+    } else {
+      if (b == 0)
+        throw "Cannot divide by zero";
+
+      overflow = (a == LLONG_MIN && b == -1);
+      if (!overflow) result = a / b;
+    }
+
+    if (overflow)
+      return bigOp(op, BigInt(a), BigInt(b));
+
+    return Dynamic(result);
+  }
+
+  // Shared by the arithmetic operators, the left-hand type decides the result
+  Dynamic numericOp(char op, const Dynamic& x) const {
+    if (type == DOUBLE) {
+      double right = x.toDouble();
+
+      if (op == '+')
+        return Dynamic(flt + right);
+      else if (op == '-')
+        return Dynamic(flt - right);
+      else if (op == '*')
+        return Dynamic(flt * right);
+
+      return Dynamic(flt / right);
+    }
+
+    if (type == INT && x.type != BIGINT)
+      return intOp(op, num, x.type == DOUBLE ? (long long)x.flt : x.num);
+
+    return bigOp(op, toBig(), x.toBig());
+  }
+
+  // -1, 0 or 1 between two numbers, exact for integers of any size
+  int compareNumber(const Dynamic& x) const {
+    if (type == INT && x.type == INT)
+      return (num > x.num) - (num < x.num);
+
+    if (type == DOUBLE || x.type == DOUBLE) {
+      double left = toDouble();
+      double right = x.toDouble();
+
+      return (left > right) - (left < right);
+    }
+
+    return toBig().compare(x.toBig());
+  }
+
+  // Assignment Operators //
+
+  Dynamic& operator= (const Dynamic& x) {
+    if (this != &x)
+      copyFrom(x);
+
+    return (*this);
+  };
+
+  Dynamic& operator= (Dynamic&& x) noexcept {
+    if (this != &x)
+      moveFrom(x);
+
+    return (*this);
+  };
+
+  Dynamic& operator= (std::string x) {
+    setString(std::move(x));
+
+    return (*this);
+  };
+
+  template<typename T>
+  IfInteger<T, Dynamic&> operator= (T x) {
+    release();
+    type = INT;
+
+    num = x;
+    return (*this);
+  };
+
+  double operator= (double x) {
+    release();
+    type = DOUBLE;
+
+    flt = x;
+    return flt;
+  };
+
+  bool operator= (bool x) {
+    release();
+    type = BOOL;
+
+    bln = x;
+    return bln;
+  };
+
+  // Arithmetic Operators //
+
+  template<typename T>
+  IfInteger<T, Dynamic> operator+ (T x) const & {
+    return (*this) + Dynamic(x);
+  }
+  template<typename T>
+  IfInteger<T, Dynamic> operator+ (T x) && {
+    return std::move(*this) + Dynamic(x);
+  }
+  Dynamic operator+ (double x) const & {
+    return (*this) + Dynamic(x);
+  }
+  Dynamic operator+ (double x) && {
+    return std::move(*this) + Dynamic(x);
+  }
+  Dynamic operator+ (const char* x) const & {
+    if (type == STRING) {
+      return concat(view(), x);
+    }
+    
+    return (*this);
+  }
+  Dynamic operator+ (const char* x) && {
+    if (type == STRING) {
+      appendString(x);
+    }
+    
+    return std::move(*this);
+  }
+  Dynamic operator+ (const std::string& x) const & {
+    if (type == STRING) {
+      return concat(view(), x);
+    } else if (type == INT) {
+      return concat(std::to_string(num), x);
+    } else if (type == DOUBLE) {
+      return concat(std::to_string(flt), x);
+    } else if (type == BOOL) {
+      return concat(bln ? "True" : "False", x);
+    }
+    
+    return (*this);
+  }
+  Dynamic operator+ (const std::string& x) && {
+    if (type == STRING) {
+      appendString(x);
+      return std::move(*this);
+    }
+
+    return static_cast<const Dynamic&>(*this) + x;
+  }
+  Dynamic operator+ (const Dynamic& x) const & {
+    if (isNumber() && x.isNumber()) {
+      return numericOp('+', x);
+    } else if (type == STRING) {
+      if (x.type == STRING)
+        return concat(view(), x.view());
+
+      return concat(view(), x.concatText());
+    } else if (type == ARRAY || x.type == ARRAY) {
+      return arrayOp('+', x);
+    }
+    
+    return (*this);
+  }
+  // Reuses the left-hand buffer, so chains like a + b + c append in place
+  Dynamic operator+ (const Dynamic& x) && {
+    if (type == STRING) {
+      if (x.type == STRING)
+        appendString(x.view());
+      else
+        appendString(x.concatText());
+
+      return std::move(*this);
+    }
+
+    return static_cast<const Dynamic&>(*this) + x;
+  }
+
+  template<typename T>
+  IfInteger<T, Dynamic> operator- (T x) const {
+    return (*this) - Dynamic(x);
+  }
+  Dynamic operator- (double x) const {
+    return (*this) - Dynamic(x);
+  }
+  Dynamic operator- (const Dynamic& x) const {
+    if (isNumber() && x.isNumber())
+      return numericOp('-', x);
+    else if (type == ARRAY || x.type == ARRAY)
+      return arrayOp('-', x);
+    
+    return (*this);
+  }
+  
+  template<typename T>
+  friend IfInteger<T, Dynamic> operator- (T x, const Dynamic& y) {
+    return Dynamic(x) - y;
+  }
+  friend Dynamic operator- (double x, const Dynamic& y) {
+    return Dynamic(x) - y;
+  }
+
+  template<typename T>
+  IfInteger<T, Dynamic> operator* (T x) const {
+    return (*this) * Dynamic(x);
+  }
+  Dynamic operator* (double x) const {
+    return (*this) * Dynamic(x);
+  }
+  Dynamic operator* (const Dynamic& x) const {
+    if (isNumber() && x.isNumber())
+      return numericOp('*', x);
+    else if (type == ARRAY || x.type == ARRAY)
+      return arrayOp('*', x);
+    
+    return (*this);
+  }
+  
+  template<typename T>
+  friend IfInteger<T, Dynamic> operator* (T x, const Dynamic& y) {
+    return Dynamic(x) * y;
+  }
+  friend Dynamic operator* (double x, const Dynamic& y) {
+    return Dynamic(x) * y;
+  }
+
+  template<typename T>
+  IfInteger<T, Dynamic> operator/ (T x) const {
+    return (*this) / Dynamic(x);
+  }
+  Dynamic operator/ (double x) const {
+    return (*this) / Dynamic(x);
+  }
+  Dynamic operator/ (const Dynamic& x) const {
+    if (isNumber() && x.isNumber())
+      return numericOp('/', x);
+    else if (type == ARRAY || x.type == ARRAY)
+      return arrayOp('/', x);
+    
+    return (*this);
+  }
+  
+  template<typename T>
+  friend IfInteger<T, Dynamic> operator/ (T x, const Dynamic& y) {
+    return Dynamic(x) / y;
+  }
+  friend Dynamic operator/ (double x, const Dynamic& y) {
+    return Dynamic(x) / y;
+  }
+
+  // x is taken by value so a temporary left-hand string is appended to in place
+  friend Dynamic operator+ (std::string x, const Dynamic& y) {
+    if (y.type == STRING) {
+      x.append(y.view());
+    } else if (y.type == INT) {
+      x.append(std::to_string(y.num));
+    } else if (y.type == DOUBLE) {
+      x.append(std::to_string(y.flt));
+    } else if (y.type == BOOL) {
+      x.append(std::to_string(y.bln));
+    }
+
+    return Dynamic(std::move(x));
+  }
+  template<typename T>
+  friend IfInteger<T, Dynamic> operator+ (T x, const Dynamic& y) {
+    return Dynamic(x) + y;
+  }
+  friend Dynamic operator+ (double x, const Dynamic& y) {
+    return Dynamic(x) + y;
+  }
+
+  Dynamic operator++ (int) {
+    if (!isNumber())
+      throw "Cannot increment a non int type";
+
+    Dynamic old = (*this);
+    (*this) = (*this) + 1;
+    return old;
+  };
+  Dynamic& operator++ () {
+    if (!isNumber())
+      throw "Cannot increment a non int type";
+
+    (*this) = (*this) + 1;
+    return (*this);
+  };
+  Dynamic operator-- (int) {
+    if (!isNumber())
+      throw "Cannot decrement a non int type";
+
+    Dynamic old = (*this);
+    (*this) = (*this) - 1;
+    return old;
+  };
+  Dynamic& operator-- () {
+    if (!isNumber())
+      throw "Cannot decrement a non int type";
+
+    (*this) = (*this) - 1;
+    return (*this);
+  };
+
+  template<typename T>
+  IfInteger<T, Dynamic&> operator+= (T x) {
+    if (!isNumber() && type != STRING)
+      throw "Cannot add assign a non int type";
+
+    return (*this) += Dynamic(x);
+  };
+  Dynamic& operator+= (double x) {
+    if (type == INT || type == BIGINT) {
+      (*this) = toDouble() + x;
+
+      return (*this);
+    } else if (!isNumber() && type != STRING) {
+      throw "Cannot add assign a non double/int type";
+    }
+
+    return (*this) += Dynamic(x);
+  };
+  Dynamic& operator+= (const char* x) {
+    if (type == STRING) {
+      appendString(x);
+      
+      return (*this);
+    };
+
+    throw "Cannot add assign a non string type";
+  };
+  Dynamic& operator+= (const Dynamic& x) {
+    if (type == STRING) {
+      if (x.type == STRING)
+        appendString(x.view());
+      else
+        appendString(x.concatText());
+    } else if (type == INT && x.type == INT) {
+      long long result;
+
+      if (__builtin_add_overflow(num, x.num, &result))
+        (*this) = numericOp('+', x);
+      else
+        num = result;
+    } else if (isNumber() && x.isNumber()) {
+      (*this) = numericOp('+', x);
+    }
+    
+    return (*this);
+  }
+  
+  template<typename T>
+  IfInteger<T, Dynamic&> operator-= (T x) {
+    if (!isNumber())
+      throw "Cannot subtract assign a non int type";
+
+    (*this) = (*this) - x;
+    return (*this);
+  };
+  Dynamic& operator-= (double x) {
+    if (type == DOUBLE) {
+      flt -= x;
+      return (*this);
+    } else if (type == INT || type == BIGINT) {
+      (*this) = toDouble() - x;
+      return (*this);
+    };
+
+    throw "Cannot subtract assign a non double/int type";
+  };
+  Dynamic& operator-= (const Dynamic& x) {
+    if (isNumber() && x.isNumber())
+      (*this) = numericOp('-', x);
+
+    return (*this);
+  };
+  Dynamic& operator*= (const Dynamic& x) {
+    (*this) = (*this) * x;
+    return (*this);
+  };
+
+  // Other Operators //
+
+
+
+  // Comparison Operators //
+
+  // Between two Dynamics: numbers by value and strings by their text,
+  // any other pair is unordered (UNORDERED) and only == to itself by type
+  static const int UNORDERED = 2;
+
+  int compare(const Dynamic& x) const {
+    if (isNumber() && x.isNumber())
+      return compareNumber(x);
+    else if (type == STRING && x.type == STRING)
+      return view().compare(x.view()) < 0 ? -1 : (view() == x.view() ? 0 : 1);
+
+    return UNORDERED;
+  }
+
+  bool operator> (const Dynamic& x) const {
+    return compare(x) == 1;
+  }
+  bool operator>= (const Dynamic& x) const {
+    int order = compare(x);
+    return order == 1 || order == 0;
+  }
+  bool operator< (const Dynamic& x) const {
+    return compare(x) == -1;
+  }
+  bool operator<= (const Dynamic& x) const {
+    int order = compare(x);
+    return order == -1 || order == 0;
+  }
+  bool operator== (const Dynamic& x) const {
+    // interned only means something for strings
+    if (type == STRING && x.type == STRING && interned && x.interned)
+      return symbol == x.symbol;
+    else if (type == BOOL || x.type == BOOL)
+      return type == BOOL ? x == bln : (*this) == x.bln;
+
+    return compare(x) == 0;
+  }
+  bool operator!= (const Dynamic& x) const {
+    return !((*this) == x);
+  }
+
+  template<typename T>
+  IfInteger<T, bool> operator> (T x) const {
+    return isNumber() && compareNumber(Dynamic(x)) > 0;
+  };
+  bool operator> (double x) const {
+    return isNumber() && compareNumber(Dynamic(x)) > 0;
+  };
+
+  template<typename T>
+  IfInteger<T, bool> operator>= (T x) const {
+    return isNumber() && compareNumber(Dynamic(x)) >= 0;
+  };
+  bool operator>= (double x) const {
+    return isNumber() && compareNumber(Dynamic(x)) >= 0;
+  };
+
+  template<typename T>
+  IfInteger<T, bool> operator< (T x) const {
+    return isNumber() && compareNumber(Dynamic(x)) < 0;
+  };
+  bool operator< (double x) const {
+    return isNumber() && compareNumber(Dynamic(x)) < 0;
+  };
+
+  template<typename T>
+  IfInteger<T, bool> operator<= (T x) const {
+    return isNumber() && compareNumber(Dynamic(x)) <= 0;
+  };
+  bool operator<= (double x) const {
+    return isNumber() && compareNumber(Dynamic(x)) <= 0;
+  };
+
+  template<typename T>
+  IfInteger<T, bool> operator== (T x) const {
+    if (isNumber()) {
+      return compareNumber(Dynamic(x)) == 0;
+    } else if (type == STRING) {
+      return view() == std::to_string(x);
+    }
+
+    return false;
+  };
+  bool operator== (double x) const {
+    if (isNumber()) {
+      return compareNumber(Dynamic(x)) == 0;
+    } else if (type == STRING) {
+      return view() == std::to_string(x);
+    }
+
+    return false;
+  };
+  bool operator== (bool x) const {
+    if (type == INT) {
+      return num == x;
+    } else if (type == DOUBLE) {
+      return flt == (double)x;
+    } else if (type == BOOL) {
+      return bln == x;
+    }
+
+    return false;
+  };
+  bool operator== (std::string_view x) const {
+    if (type == STRING) {
+      return view() == x;
+    }
+
+    return false;
+  }
+  bool operator== (const std::string& x) const {
+    return (*this) == std::string_view(x);
+  }
+  bool operator== (const char* x) const {
+    return (*this) == std::string_view(x);
+  }
+
+  friend bool operator== (const std::string& x, const Dynamic& y) {
+    return y == x;
+  }
+  template<typename T>
+  friend IfInteger<T, bool> operator== (T x, const Dynamic& y) {
+    return y == x;
+  }
+  friend bool operator== (double x, const Dynamic& y) {
+    return y == x;
+  }
+  friend bool operator== (bool x, const Dynamic& y) {
+    return y == x;
+  }
+
+  template<typename T>
+  IfInteger<T, bool> operator!= (T x) const {
+    return !((*this) == x);
+  }
+  bool operator!= (double x) const {
+    return !((*this) == x);
+  }
+  bool operator!= (bool x) const {
+    return !((*this) == x);
+  }
+  bool operator!= (std::string_view x) const {
+    return !((*this) == x);
+  }
+  bool operator!= (const std::string& x) const {
+    return !((*this) == x);
+  }
+  bool operator!= (const char* x) const {
+    return !((*this) == x);
+  }
+
+  friend bool operator!= (const std::string& x, const Dynamic& y) {
+    return y != x;
+  }
+  template<typename T>
+  friend IfInteger<T, bool> operator!= (T x, const Dynamic& y) {
+    return y != x;
+  }
+  friend bool operator!= (double x, const Dynamic& y) {
+    return y != x;
+  }
+  friend bool operator!= (bool x, const Dynamic& y) {
+    return y != x;
+  }
+
+  // Native numbers on the left, as emitted for typed ADK locals
+  template<typename T>
+  friend IfInteger<T, bool> operator> (T x, const Dynamic& y) {
+    return y < x;
+  }
+  friend bool operator> (double x, const Dynamic& y) {
+    return y < x;
+  }
+  template<typename T>
+  friend IfInteger<T, bool> operator>= (T x, const Dynamic& y) {
+    return y <= x;
+  }
+  friend bool operator>= (double x, const Dynamic& y) {
+    return y <= x;
+  }
+  template<typename T>
+  friend IfInteger<T, bool> operator< (T x, const Dynamic& y) {
+    return y > x;
+  }
+  friend bool operator< (double x, const Dynamic& y) {
+    return y > x;
+  }
+  template<typename T>
+  friend IfInteger<T, bool> operator<= (T x, const Dynamic& y) {
+    return y >= x;
+  }
+  friend bool operator<= (double x, const Dynamic& y) {
+    return y >= x;
+  }
+
+  std::string getString() const {
+    return std::string(view());
+  }
+
+  // BIGINT values saturate to the 64-bit range
+  long long getInt() const {
+    if (type == BIGINT)
+      return big->negative ? LLONG_MIN : LLONG_MAX;
+
+    return num;
+  }
+
+  double getDouble() const {
+    return flt;
+  }
+
+  bool getBoolean() const {
+    return bln;
+  }
+
+  // Other Dynamic Types //
+
+  Dynamic(const std::string& ctype, const char* value) {
+    type = BOOL;
+    bln = 0;
+
+    construct(ctype, value);
+  }
+  Dynamic(const std::string& ctype, const std::string& value) {
+    type = BOOL;
+    bln = 0;
+
+    construct(ctype, value);
+  }
+
+  void construct(const char* ctype, const char* value) {
+    if (std::string(ctype) == std::string("FILE")) {
+      release();
+      adkfile = new ADKFile(value);
+      type = FILE;
+    }
+  }
+  void construct(const std::string& ctype, const std::string& value) {
+    construct(ctype.c_str(), value.c_str());
+  }
+  void construct(const std::string& ctype, const char* value) {
+    construct(ctype.c_str(), value);
+  }
+  void construct(const std::string& ctype, const Dynamic& value) {
+    construct(ctype.c_str(), value.getString());
+  }
+  void construct(const Dynamic& ctype, const char* value) {
+    construct(ctype.getString(), value);
+  }
+  void construct(const Dynamic& ctype, const Dynamic& value) {
+    construct(ctype.getString(), value.getString());
+  }
+
+  // File System //
+
+  std::string read() {
+    return adkfile->read();
+  };
+
+  std::string_view map() {
+    return adkfile->map();
+  };
+
+  ADKFile::Stream lines() {
+    if (type != FILE)
+      throw "Cannot stream lines from a non file type";
+
+    return adkfile->lines();
+  };
+
+  template<typename T>
+  IfInteger<T, ADKFile::Stream> chunks(T size) {
+    if (type != FILE)
+      throw "Cannot stream chunks from a non file type";
+
+    return adkfile->chunks(size);
+  };
+
+  ADKFile::Stream chunks(const Dynamic& size) {
+    return chunks(size.getInt());
+  };
+
+  template<typename T>
+  void append(const T& str) {
+    adkfile->append(str);
+  }
+
+  template<typename T>
+  void write(const T& str) {
+    adkfile->write(str);
+  }
+
+  void flush() {
+    adkfile->flush();
+  }
+
+  void wait() {
+    adkfile->wait();
+  }
+
+  // Closes the handle for every copy of the file, not just this one
+  void close() {
+    if (type == FILE)
+      adkfile->close();
+
+    release();
+  }
+
+  // Collections //
+  // Defined below, once DynamicList and DynamicMap are complete
+
+  class Each;
+
+  static Dynamic newList(std::initializer_list<Dynamic> values);
+  static Dynamic newMap(std::initializer_list<std::pair<Dynamic, Dynamic>> entries);
+
+  void shareCollection(const Dynamic& x);
+  void releaseCollection();
+
+  NumericArray toArray() const;
+  Dynamic arrayOp(char op, const Dynamic& x) const;
+  Dynamic get(const Dynamic& key) const;
+  std::string formatCollection() const;
+
+  Dynamic& operator[] (const Dynamic& key);
+  const Dynamic& operator[] (const Dynamic& key) const;
+
+  void set(const Dynamic& key, Dynamic value);
+  void push(Dynamic value);
+  Dynamic pop();
+  void remove(const Dynamic& key);
+
+  long long size() const;
+  bool has(const Dynamic& key) const;
+
+  Dynamic keys() const;
+  Dynamic values() const;
+
+  Each each() const;
+};
+
+static_assert(sizeof(Dynamic) == 16, "Dynamic should stay two words wide");
+
+// Collections //
+// LIST and MAP are shared by reference, like in most scripting languages:
+// copying the Dynamic copies a pointer and bumps a count. A collection
+// that ends up containing itself is never freed.
+
+class DynamicList {
+  public:
+
+  size_t references = 1;
+  std::vector<Dynamic> items;
+};
+
+// Insertion ordered hash map. Entries sit in one contiguous vector and
+// an open-addressing (linear probing) table of indices points into it.
+// Each entry keeps its key's hash, so growing never rehashes a string and
+// most mismatches are rejected without comparing keys.
+class DynamicMap {
+  public:
+
+  static constexpr int32_t EMPTY = -1;
+  static constexpr int32_t REMOVED = -2;
+
+  struct Entry {
+    uint64_t hash;
+    Dynamic key;
+    Dynamic value;
+    bool alive;
+  };
+
+  size_t references = 1;
+  size_t count = 0;
+
+  std::vector<Entry> entries;
+  std::vector<int32_t> slots;
+
+  static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+  }
+
+  static uint64_t hashOf(const Dynamic& key) {
+    if (key.type == key.STRING)
+      return key.interned ? key.symbol->hash : std::hash<std::string_view>{}(key.view());
+    else if (key.type == key.INT)
+      return mix(key.num);
+    else if (key.type == key.BOOL)
+      return mix(key.bln + 1);
+    else if (key.type == key.BIGINT)
+      return std::hash<std::string>{}(key.big->toString());
+    else if (key.type == key.DOUBLE) {
+      uint64_t bits;
+      std::memcpy(&bits, &key.flt, sizeof(bits));
+      return mix(bits);
+    }
+
+    throw "Cannot use a list, map or file as a key";
+  }
+
+  static bool sameKey(const Dynamic& a, const Dynamic& b) {
+    if (a.type != b.type)
+      return false;
+    else if (a.type == a.STRING && a.interned && b.interned)
+      return a.symbol == b.symbol;
+    else if (a.type == a.STRING)
+      return a.view() == b.view();
+    else if (a.type == a.INT)
+      return a.num == b.num;
+    else if (a.type == a.DOUBLE)
+      return a.flt == b.flt;
+    else if (a.type == a.BOOL)
+      return a.bln == b.bln;
+    else if (a.type == a.BIGINT)
+      return a.big->compare(*b.big) == 0;
+
+    return false;
+  }
+
+  // Slot holding the key, or the empty slot its probe ended on
+  size_t probe(const Dynamic& key, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      int32_t index = slots[i];
+
+      if (index == EMPTY)
+        return i;
+      else if (index >= 0 && entries[index].hash == hash && sameKey(entries[index].key, key))
+        return i;
+    }
+  }
+
+  Dynamic* find(const Dynamic& key) {
+    if (count == 0)
+      return nullptr;
+
+    int32_t index = slots[probe(key, hashOf(key))];
+    return index >= 0 ? &entries[index].value : nullptr;
+  }
+
+  void set(const Dynamic& key, Dynamic value) {
+    uint64_t hash = hashOf(key);
+
+    if (count > 0) {
+      int32_t index = slots[probe(key, hash)];
+
+      if (index >= 0) {
+        entries[index].value = std::move(value);
+        return;
+      }
+    }
+
+    // Removed entries still hold their slot, so they count toward the load
+    if ((entries.size() + 1) * 4 > slots.size() * 3)
+      rebuild();
+
+    slots[probe(key, hash)] = entries.size();
+    entries.push_back({ hash, key, std::move(value), true });
+    count++;
+  }
+
+  void remove(const Dynamic& key) {
+    if (count == 0)
+      return;
+
+    size_t slot = probe(key, hashOf(key));
+    int32_t index = slots[slot];
+
+    if (index < 0)
+      return;
+
+    slots[slot] = REMOVED;
+    entries[index].alive = false;
+    entries[index].key = Dynamic();
+    entries[index].value = Dynamic();
+    count--;
+  }
+
+  // Drops removed entries and re-slots the rest from their cached hashes
+  void rebuild() {
+    std::vector<Entry> live;
+    live.reserve(count + 1);
+
+    for (Entry& entry : entries) {
+      if (entry.alive)
+        live.push_back(std::move(entry));
+    }
+
+    entries.swap(live);
+
+    size_t capacity = 8;
+    while (capacity * 3 < (count + 1) * 8)
+      capacity *= 2;
+
+    slots.assign(capacity, EMPTY);
+    size_t mask = capacity - 1;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+      size_t slot = entries[i].hash & mask;
+
+      while (slots[slot] != EMPTY)
+        slot = (slot + 1) & mask;
+
+      slots[slot] = i;
+    }
+  }
+};
+
+inline Dynamic Dynamic::newList(std::initializer_list<Dynamic> values) {
+  Dynamic result;
+
+  result.list = new DynamicList();
+  result.list->items.assign(values.begin(), values.end());
+  result.type = LIST;
+
+  return result;
+}
+
+inline Dynamic Dynamic::newMap(std::initializer_list<std::pair<Dynamic, Dynamic>> entries) {
+  Dynamic result;
+
+  result.dict = new DynamicMap();
+  result.type = MAP;
+
+  for (const auto& [key, value] : entries)
+    result.dict->set(key, value);
+
+  return result;
+}
+
+inline void Dynamic::shareCollection(const Dynamic& x) {
+  if (x.type == LIST) {
+    list = x.list;
+    list->references++;
+  } else if (x.type == ARRAY) {
+    packed = x.packed;
+    packed->references++;
+  } else {
+    dict = x.dict;
+    dict->references++;
+  }
+}
+
+inline void Dynamic::releaseCollection() {
+  if (type == LIST && --list->references == 0)
+    delete list;
+  else if (type == MAP && --dict->references == 0)
+    delete dict;
+  else if (type == ARRAY && --packed->references == 0)
+    delete packed;
+}
+
+// [1, "two", True] and {"key": 1}, strings inside are quoted
+inline std::string Dynamic::formatCollection() const {
+  if (type == ARRAY)
+    return toArray().toString();
+
+  std::string text;
+
+  auto element = [&](const Dynamic& value) {
+    if (value.type == STRING) {
+      text.append("\"").append(value.view()).append("\"");
+    } else if (value.type == BOOL) {
+      text.append(value.bln ? "True" : "False");
+    } else if (value.type == DOUBLE) {
+      std::ostringstream stream;
+      stream << value.flt;
+      text.append(stream.str());
+    } else {
+      text.append(value.concatText());
+    }
+  };
+
+  if (type == LIST) {
+    text += '[';
 
-      return Dynamic(flt * x.flt);
+    for (size_t i = 0; i < list->items.size(); i++) {
+      if (i > 0) text.append(", ");
+      element(list->items[i]);
     }
-    
-    return (*this);
-  }
 
-  friend Dynamic operator* (int x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x * y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x * (int)y.flt);
+    text += ']';
+  } else if (type == MAP) {
+    bool first = true;
+    text += '{';
+
+    for (const DynamicMap::Entry& entry : dict->entries) {
+      if (!entry.alive)
+        continue;
+
+      if (!first) text.append(", ");
+      first = false;
+
+      element(entry.key);
+      text.append(": ");
+      element(entry.value);
     }
 
-    return Dynamic(x);
+    text += '}';
   }
-  friend Dynamic operator* (double x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x * (double)y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x * y.flt);
-    }
 
-    return Dynamic(x);
+  return text;
+}
+
+// Lists take an INT index, negative ones count from the end. Reading a
+// missing map key throws, set() is what adds one.
+inline Dynamic& Dynamic::operator[] (const Dynamic& key) {
+  if (type == LIST) {
+    if (key.type != INT)
+      throw "List indices must be ints";
+
+    long long size = list->items.size();
+    long long index = key.num < 0 ? key.num + size : key.num;
+
+    if (index < 0 || index >= size)
+      throw "List index out of range";
+
+    return list->items[index];
+  } else if (type == MAP) {
+    Dynamic* value = dict->find(key);
+
+    if (!value)
+      throw "Key not found in map";
+
+    return *value;
+  } else if (type == ARRAY) {
+    throw "Numeric array elements are read with get()";
   }
 
-  Dynamic operator/ (int x) {
-    if (type == INT) {
-      return Dynamic(num / x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt / (double)x);
-    }
-    
-    return (*this);
+  throw "Cannot index a non list/map type";
+}
+
+inline const Dynamic& Dynamic::operator[] (const Dynamic& key) const {
+  return const_cast<Dynamic&>(*this)[key];
+}
+
+// value is taken by value so it's copied before the map can grow under it
+inline void Dynamic::set(const Dynamic& key, Dynamic value) {
+  if (type == MAP)
+    dict->set(key, std::move(value));
+  else if (type == ARRAY)
+    toArray().set(key, value);
+  else
+    (*this)[key] = std::move(value);
+}
+
+inline void Dynamic::push(Dynamic value) {
+  if (type == ARRAY)
+    return toArray().push(value);
+  else if (type != LIST)
+    throw "Cannot push to a non list type";
+
+  list->items.push_back(std::move(value));
+}
+
+inline Dynamic Dynamic::pop() {
+  if (type != LIST)
+    throw "Cannot pop from a non list type";
+  else if (list->items.empty())
+    throw "Cannot pop from an empty list";
+
+  Dynamic value = std::move(list->items.back());
+  list->items.pop_back();
+
+  return value;
+}
+
+// A key from a map, an index from a list
+inline void Dynamic::remove(const Dynamic& key) {
+  if (type == MAP) {
+    dict->remove(key);
+  } else if (type == LIST) {
+    Dynamic& item = (*this)[key];
+    list->items.erase(list->items.begin() + (&item - list->items.data()));
+  } else {
+    throw "Cannot remove from a non list/map type";
   }
-  Dynamic operator/ (double x) {
-    if (type == INT) {
-      return Dynamic(num / (int)x);
-    } else if (type == DOUBLE) {
-      return Dynamic(flt / x);
-    }
-    
-    return (*this);
+}
+
+inline long long Dynamic::size() const {
+  if (type == LIST)
+    return list->items.size();
+  else if (type == MAP)
+    return dict->count;
+  else if (type == ARRAY)
+    return packed->isDouble ? packed->doubles.size() : packed->ints.size();
+  else if (type == STRING)
+    return view().size();
+
+  throw "Cannot take the size of this type";
+}
+
+// A key of a map, an element of a list
+inline bool Dynamic::has(const Dynamic& key) const {
+  if (type == MAP)
+    return dict->find(key) != nullptr;
+  else if (type == LIST)
+    return std::any_of(list->items.begin(), list->items.end(),
+      [&](const Dynamic& item) { return DynamicMap::sameKey(item, key); });
+
+  throw "Cannot search a non list/map type";
+}
+
+inline Dynamic Dynamic::keys() const {
+  if (type != MAP)
+    throw "Cannot take the keys of a non map type";
+
+  Dynamic result = newList({});
+  result.list->items.reserve(dict->count);
+
+  for (const DynamicMap::Entry& entry : dict->entries) {
+    if (entry.alive)
+      result.list->items.push_back(entry.key);
   }
-  Dynamic operator/ (Dynamic x) {
-    if (type == INT) {
-      if (x.type == DOUBLE)
-        return num * (int)flt;
 
-      return Dynamic(num / x.num);
-    } else if (type == DOUBLE) {
-      if (x.type == INT)
-        return flt / (double)x.num;
+  return result;
+}
 
-      return Dynamic(flt / x.flt);
-    }
-    
-    return (*this);
-  }
-  
-  friend Dynamic operator/ (int x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x / y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x / (int)y.flt);
-    }
+inline Dynamic Dynamic::values() const {
+  if (type != MAP)
+    throw "Cannot take the values of a non map type";
 
-    return Dynamic(x);
-  }
-  friend Dynamic operator/ (double x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x / (double)y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x / y.flt);
-    }
+  Dynamic result = newList({});
+  result.list->items.reserve(dict->count);
 
-    return Dynamic(x);
+  for (const DynamicMap::Entry& entry : dict->entries) {
+    if (entry.alive)
+      result.list->items.push_back(entry.value);
   }
 
-  friend Dynamic operator+ (std::string x, Dynamic y) {
-    if (y.type == STRING) {
-      return Dynamic(x + y.str);
-    } else if (y.type == INT) {
-      return Dynamic(x + std::to_string(y.num));
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x + std::to_string(y.flt));
-    } else if (y.type == BOOL) {
-      return Dynamic(x + std::to_string(y.bln));
-    }
+  return result;
+}
 
-    return Dynamic(x);
-  }
-  friend Dynamic operator+ (int x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x + y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x + (int)y.flt);
-    }
+// Numeric Array Values //
+
+inline NumericArray Dynamic::toArray() const {
+  if (type == ARRAY)
+    return NumericArray(packed);
+  else if (type != LIST)
+    throw "Cannot make a numeric array from this type";
+
+  bool isDouble = std::any_of(list->items.begin(), list->items.end(),
+    [](const Dynamic& item) { return item.type == DOUBLE; });
 
-    return Dynamic(x);
+  NumericArray result(list->items.size(), isDouble);
+
+  for (size_t i = 0; i < list->items.size(); i++) {
+    const Dynamic& item = list->items[i];
+
+    if (item.type != INT && item.type != DOUBLE)
+      throw "Numeric arrays only hold ints and doubles";
+
+    if (isDouble)
+      result.data->doubles[i] = item.toDouble();
+    else
+      result.data->ints[i] = item.num;
   }
-  friend Dynamic operator+ (double x, Dynamic y) {
-    if (y.type == INT) {
-      return Dynamic(x + (double)y.num);
-    } else if (y.type == DOUBLE) {
-      return Dynamic(x + y.flt);
-    }
 
-    return Dynamic(x);
+  return result;
+}
+
+// Array with array, or array with a number on either side
+inline Dynamic Dynamic::arrayOp(char op, const Dynamic& x) const {
+  if (type == ARRAY && x.type == ARRAY)
+    return NumericArray::arithmetic(op, toArray(), x.toArray());
+
+  const Dynamic& array = type == ARRAY ? *this : x;
+  const Dynamic& number = type == ARRAY ? x : *this;
+
+  if (number.type == INT)
+    return array.toArray().scalar(op, number.num, type != ARRAY);
+  else if (number.type == DOUBLE)
+    return array.toArray().scalar(op, number.flt, type != ARRAY);
+
+  throw "Arrays only combine with arrays, ints and doubles";
+}
+
+// Element by value, the only way to read a packed array
+inline Dynamic Dynamic::get(const Dynamic& key) const {
+  if (type == ARRAY)
+    return toArray().get(key);
+
+  return (*this)[key];
+}
+
+inline Dynamic NumericArray::get(const Dynamic& index) const {
+  if (index.type != index.INT)
+    throw "Array indices must be ints";
+
+  size_t at = position(index.num);
+  return data->isDouble ? Dynamic(data->doubles[at]) : Dynamic(data->ints[at]);
+}
+
+// A double stored into an int array turns the whole array into doubles
+inline void NumericArray::set(const Dynamic& index, const Dynamic& value) {
+  if (index.type != index.INT)
+    throw "Array indices must be ints";
+  else if (value.type != value.INT && value.type != value.DOUBLE)
+    throw "Numeric arrays only hold ints and doubles";
+
+  size_t at = position(index.num);
+
+  if (!data->isDouble && value.type == value.DOUBLE) {
+    data->doubles = asDoubles();
+    data->ints.clear();
+    data->ints.shrink_to_fit();
+    data->isDouble = true;
   }
 
-  int operator++ (int) {
-    if (type == INT) {
-      return ++num;
-    } else if (type == DOUBLE) {
-      flt += 1.0;
-      return flt;
-    }
+  if (data->isDouble)
+    data->doubles[at] = value.toDouble();
+  else
+    data->ints[at] = value.num;
+}
+
+inline void NumericArray::push(const Dynamic& value) {
+  if (value.type != value.INT && value.type != value.DOUBLE)
+    throw "Numeric arrays only hold ints and doubles";
+
+  if (!data->isDouble && value.type == value.DOUBLE) {
+    data->doubles = asDoubles();
+    data->ints.clear();
+    data->ints.shrink_to_fit();
+    data->isDouble = true;
+  }
 
-    throw "Cannot increment a non int type";
-  };
-  int operator++ () {
-    if (type == INT) {
-      return num++;
-    } else {
-      double old = flt;
-      flt += 1.0;
-      return old;
-    }
+  if (data->isDouble)
+    data->doubles.push_back(value.toDouble());
+  else
+    data->ints.push_back(value.num);
+}
 
-    throw "Cannot increment a non int type";
-  };
-  int operator-- (int) {
-    if (type == INT) {
-      return --num;
-    } else {
-      flt -= 1;
-      return flt;
-    }
+// An int sum that overflows is redone through Dynamic and comes out a BIGINT
+inline Dynamic NumericArray::sum() const {
+  if (data->isDouble)
+    return Dynamic(sumDoubles(data->doubles.data(), data->doubles.size()));
 
-    throw "Cannot decrement a non int type";
-  };
-  int operator-- () {
-    if (type == INT) {
-      return num--;
-    } else {
-      double old = flt;
-      flt -= 1;
-      return old;
-    }
+  long long total;
+  if (sumInts(data->ints.data(), data->ints.size(), total))
+    return Dynamic(total);
 
-    throw "Cannot decrement a non int type";
-  };
+  Dynamic result(0LL);
+  for (long long x : data->ints)
+    result += x;
 
-  void operator+= (int x) {
-    if (type == INT) {
-      num += x;
+  return result;
+}
 
-      return;
-    } else if (type == DOUBLE) {
-      flt += (double)x;
+inline Dynamic NumericArray::min() const {
+  if (size() == 0)
+    throw "Cannot take the min of an empty array";
 
-      return;
-    } else if (type == STRING) {
-      str = str + std::to_string(x);
+  if (data->isDouble)
+    return Dynamic(reduce(data->doubles.data(), size(), [](double a, double b) { return b < a ? b : a; }));
 
-      return;
-    };
+  return Dynamic(reduce(data->ints.data(), size(), [](long long a, long long b) { return b < a ? b : a; }));
+}
 
-    throw "Cannot add assign a non int type";
-  };
-  void operator+= (double x) {
-    if (type == DOUBLE) {
-      flt += x;
+inline Dynamic NumericArray::max() const {
+  if (size() == 0)
+    throw "Cannot take the max of an empty array";
 
-      return;
-    } else if (type == INT) {
-      type = DOUBLE;
-      flt = (double)num + x;
+  if (data->isDouble)
+    return Dynamic(reduce(data->doubles.data(), size(), [](double a, double b) { return b > a ? b : a; }));
 
-      return;
-    } else if (type == STRING) {
-      str = str + std::to_string(x);
-      return;
-    };
+  return Dynamic(reduce(data->ints.data(), size(), [](long long a, long long b) { return b > a ? b : a; }));
+}
 
-    throw "Cannot add assign a non double/int type";
-  };
-  void operator+= (const char* x) {
-    if (type == STRING) {
-      str = str + x;
-      
-      return;
-    };
+inline Dynamic NumericArray::dot(const NumericArray& x) const {
+  if (size() != x.size())
+    throw "Arrays must be the same size";
 
-    throw "Cannot add assign a non string type";
-  };
-  Dynamic operator+= (Dynamic x) {
-    if (type == STRING) {
-      str = str + x.str;
-    } else if (type == INT) {
-      if (x.type == DOUBLE)
-        num += (int)x.flt;
-      else
-        num += x.num;
-    } else if (type == DOUBLE) {
-      if (x.type == INT)
-        flt += (double)x.num;
-      else
-        flt += x.flt;
-    }
-    
-    return (*this);
+  if (data->isDouble || x.isDouble()) {
+    std::vector<double> left, right;
+    return Dynamic(dotDoubles(doublesOf(left), x.doublesOf(right), size()));
   }
-  
-  int operator-= (int x) {
-    if (type == INT) {
-      num -= x;
-      return num;
-    };
 
-    throw "Cannot subtract assign a non int type";
-  };
-  double operator-= (double x) {
-    if (type == DOUBLE) {
-      flt += x;
-      return flt;
-    } else if (type == INT) {
-      type = DOUBLE;
-      flt = (double)num - x;
-      return flt;
-    };
+  long long total;
+  if (dotInts(data->ints.data(), x.data->ints.data(), size(), total))
+    return Dynamic(total);
 
-    throw "Cannot subtract assign a non double/int type";
-  };
+  Dynamic result(0LL);
+  for (size_t i = 0; i < size(); i++)
+    result += Dynamic(data->ints[i]) * Dynamic(x.data->ints[i]);
 
-  // Other Operators //
+  return result;
+}
 
+inline std::string NumericArray::toString() const {
+  std::ostringstream stream;
+  stream << '[';
 
+  for (size_t i = 0; i < size(); i++) {
+    if (i > 0) stream << ", ";
 
-  // Comparison Operators //
+    if (data->isDouble)
+      stream << data->doubles[i];
+    else
+      stream << data->ints[i];
+  }
 
-  bool operator> (int x) {
-    if (type == INT) {
-      return num > x;
-    } else if (type == DOUBLE) {
-      return flt > (double)x;
-    }
+  stream << ']';
+  return stream.str();
+}
 
-    return false;
-  };
-  bool operator> (double x) {
-    if (type == INT) {
-      return (double)num > x;
-    } else if (type == DOUBLE) {
-      return flt > x;
-    }
+// range(stop), range(start, stop) and range(start, stop, step), like Python's.
+// A for loop over ints counts natively instead, this is for everything else.
+inline NumericArray range(long long start, long long stop, long long step = 1) {
+  if (step == 0)
+    throw "range() step can't be zero";
 
-    return false;
-  };
+  // Counted in unsigned so bounds far apart can't overflow
+  unsigned long long count = 0;
 
-  bool operator>= (int x) {
-    if (type == INT) {
-      return num >= x;
-    } else if (type == DOUBLE) {
-      return flt >= (double)x;
-    }
+  if (step > 0 && start < stop)
+    count = ((unsigned long long)stop - start - 1) / step + 1;
+  else if (step < 0 && start > stop)
+    count = ((unsigned long long)start - stop - 1) / (0ULL - (unsigned long long)step) + 1;
 
-    return false;
-  };
-  bool operator>= (double x) {
-    if (type == INT) {
-      return (double)num >= x;
-    } else if (type == DOUBLE) {
-      return flt >= (double)x;
-    }
+  NumericArray result(count);
 
-    return false;
-  };
+  for (size_t i = 0; i < count; i++)
+    result.data->ints[i] = (long long)((unsigned long long)start + i * (unsigned long long)step);
 
-  bool operator< (int x) {
-    if (type == INT) {
-      return num < x;
-    } else if (type == DOUBLE) {
-      return flt < (double)x;
-    }
+  return result;
+}
 
-    return false;
-  };
-  bool operator< (double x) {
-    if (type == INT) {
-      return (double)num < x;
-    } else if (type == DOUBLE) {
-      return flt < (double)x;
-    }
+inline NumericArray range(long long stop) {
+  return range(0, stop);
+}
 
-    return false;
-  };
+inline long long rangeBound(const Dynamic& value) {
+  if (value.type != Dynamic::INT)
+    throw "range() only takes ints";
 
-  bool operator<= (int x) {
-    if (type == INT) {
-      return num <= x;
-    } else if (type == DOUBLE) {
-      return flt <= (double)x;
-    }
+  return value.num;
+}
 
-    return false;
-  };
-  bool operator<= (double x) {
-    if (type == INT) {
-      return (double)num <= x;
-    } else if (type == DOUBLE) {
-      return flt <= (double)x;
-    }
+inline NumericArray range(const Dynamic& start, const Dynamic& stop, const Dynamic& step = Dynamic(1)) {
+  return range(rangeBound(start), rangeBound(stop), rangeBound(step));
+}
 
-    return false;
-  };
+inline NumericArray range(const Dynamic& stop) {
+  return range(0, rangeBound(stop));
+}
 
-  bool operator== (int x) {
-    if (type == INT) {
-      return num == x;
-    } else if (type == DOUBLE) {
-      return flt == (double)x;
-    } else if (type == STRING) {
-      return str == std::to_string(x);
-    }
+// Range-for over a value: the items of a list or array, the keys of a
+// map, the characters of a string or the lines of a file. Lists and maps are
+// shared for the whole loop, so a temporary can be looped over.
+class Dynamic::Each {
+  public:
 
-    return false;
-  };
-  bool operator== (double x) {
-    if (type == INT) {
-      return (double)num == x;
-    } else if (type == DOUBLE) {
-      return flt == (double)x;
-    } else if (type == STRING) {
-      return str == std::to_string(x);
+  class iterator {
+    public:
+
+    Each* each;
+
+    const Dynamic& operator* () const {
+      return each->current();
     }
 
-    return false;
-  };
-  bool operator== (bool x) {
-    if (type == INT) {
-      return num == x;
-    } else if (type == DOUBLE) {
-      return flt == (double)x;
-    } else if (type == BOOL) {
-      return bln == x;
+    iterator& operator++ () {
+      each->advance(false);
+      return (*this);
     }
 
-    return false;
-  };
-  bool operator== (std::string x) {
-    if (type == STRING) {
-      return str == x;
+    bool operator!= (const iterator&) const {
+      return !each->done;
     }
+  };
 
-    return false;
-  }
+  Dynamic source;
+  std::unique_ptr<StreamReader> reader;
+  Dynamic item;
+
+  size_t index = 0;
+  bool done = false;
+
+  explicit Each(const Dynamic& value)
+    : source(value)
+  {
+    if (source.type == FILE) {
+      source.adkfile->wait();
+      reader.reset(new StreamReader(source.adkfile->filename));
+    } else if (source.type != LIST && source.type != MAP && source.type != STRING && source.type != ARRAY) {
+      throw "Cannot loop over this type";
+    }
+  };
 
-  friend bool operator== (std::string x, Dynamic y) {
-    return y == x;
-  }
-  friend bool operator== (int x, Dynamic y) {
-    return y == x;
-  }
-  friend bool operator== (double x, Dynamic y) {
-    return y == x;
-  }
-  friend bool operator== (bool x, Dynamic y) {
-    return y == x;
-  }
+  Each(const Each&) = delete;
+  Each& operator= (const Each&) = delete;
 
-  std::string getString() {
-    return str;
-  }
+  const Dynamic& current() const {
+    if (source.type == LIST)
+      return source.list->items[index];
+    else if (source.type == MAP)
+      return source.dict->entries[index].key;
 
-  int getInt() {
-    return num;
+    return item;
   }
 
-  double getDouble() {
-    return flt;
-  }
+  void advance(bool first) {
+    if (!first)
+      index++;
 
-  bool getBoolean() {
-    return bln;
-  }
+    if (source.type == LIST) {
+      done = index >= source.list->items.size();
+    } else if (source.type == MAP) {
+      while (index < source.dict->entries.size() && !source.dict->entries[index].alive)
+        index++;
 
-  // Other Dynamic Types //
+      done = index >= source.dict->entries.size();
+    } else if (source.type == STRING) {
+      done = index >= source.view().size();
 
-  ADKFile adkfile;
+      if (!done)
+        item.assignString(source.view().substr(index, 1));
+    } else if (source.type == ARRAY) {
+      const NumericArray::Data& packed = *source.packed;
+      done = index >= (packed.isDouble ? packed.doubles.size() : packed.ints.size());
 
-  Dynamic(std::string ctype, const char* value) {
-    construct(ctype, value);
-  }
-  Dynamic(std::string ctype, std::string value) {
-    construct(ctype, value);
-  }
+      if (!done)
+        item = packed.isDouble ? Dynamic(packed.doubles[index]) : Dynamic(packed.ints[index]);
+    } else {
+      std::string_view line;
+      done = !reader->line(line);
 
-  void construct(const char* ctype, const char* value) {
-    if (std::string(ctype) == std::string("FILE")) {
-      adkfile = ADKFile(value);
-      type = FILE;
+      if (!done)
+        item.assignString(line);
     }
   }
-  void construct(std::string ctype, std::string value) {
-    construct(ctype.c_str(), value.c_str());
-  }
-  void construct(std::string ctype, const char* value) {
-    construct(ctype.c_str(), value);
-  }
-  void construct(std::string ctype, Dynamic value) {
-    construct(ctype.c_str(), value.getString());
-  }
-  void construct(Dynamic ctype, const char* value) {
-    construct(ctype.getString(), value);
+
+  iterator begin() {
+    advance(true);
+    return { this };
   }
-  void construct(Dynamic ctype, Dynamic value) {
-    construct(ctype.getString(), value.getString());
+
+  iterator end() {
+    return { this };
   }
+};
 
-  // File System //
+inline Dynamic::Each Dynamic::each() const {
+  return Each(*this);
+}
 
-  std::string read() {
-    return adkfile.read();
-  };
+// Checked Integers //
+// Typed (non-Dynamic) ADK integers can't change type at runtime. They
+// only add or subtract small constants, everything that can grow is left
+// Dynamic by inference, so an overflow here is reported, never wrapped.
 
-  template<typename T>
-  void append(T str) {
-    adkfile.append(str);
-  }
+inline long long checkedAdd(long long a, long long b) {
+  long long result;
+  if (__builtin_add_overflow(a, b, &result))
+    throw std::overflow_error("Integer overflow in '+'");
 
-  template<typename T>
-  void write(T str) {
-    adkfile.write(str);
-  }
+  return result;
+}
 
-  void close() {
-    free(&adkfile);
-  }
-};
+inline long long checkedSub(long long a, long long b) {
+  long long result;
+  if (__builtin_sub_overflow(a, b, &result))
+    throw std::overflow_error("Integer overflow in '-'");
+
+  return result;
+}
 
 inline std::ostream& operator<< (std::ostream& out, const Dynamic& dynamic) {
   int type = dynamic.type;
   if (type == dynamic.STRING) {
-    out << std::string(dynamic.str);
+    out << dynamic.view();
   } else if (type == dynamic.INT) {
     out << dynamic.num;
   } else if (type == dynamic.DOUBLE) {
     out << dynamic.flt;
+  } else if (type == dynamic.BIGINT) {
+    out << dynamic.big->toString();
   } else if (type == dynamic.BOOL) {
     out << (dynamic.bln ? "True" : "False");
+  } else if (type == dynamic.LIST || type == dynamic.MAP || type == dynamic.ARRAY) {
+    out << dynamic.formatCollection();
   }
 
   return out;
@@ -742,4 +3252,41 @@ inline std::ostream& operator<< (std::ostream& out, const Dynamic& dynamic) {
 inline std::string operator+ (bool bln, const std::string& str) {
   std::string blnstr = (bln ? "True" : "False");
   return blnstr + str;
-}
\ No newline at end of file
+}
+
+// Type Profile //
+// Used by the first training run of a pgo build. Probed call arguments
+// record which Dynamic types they held, and at exit each site is written
+// to the file named by $ADK_TYPE_PROFILE as a "<site> <mask of TYPES>" line.
+
+class TypeProfile {
+  public:
+
+  std::vector<std::pair<const char*, unsigned>> sites;
+
+  ~TypeProfile() {
+    const char* path = getenv("ADK_TYPE_PROFILE");
+    if (path == nullptr)
+      return;
+
+    std::ofstream file(path);
+
+    for (const auto& [name, types] : sites)
+      file << name << ' ' << types << '\n';
+  }
+
+  static TypeProfile& get() {
+    static TypeProfile profile;
+    return profile;
+  }
+
+  static size_t site(const char* name) {
+    get().sites.push_back({ name, 0 });
+    return get().sites.size() - 1;
+  }
+
+  static const Dynamic& probe(size_t site, const Dynamic& value) {
+    get().sites[site].second |= 1u << value.type;
+    return value;
+  }
+};
@@ -0,0 +1,9 @@
+#ifndef ADK_RUNTIME_HPP
+#define ADK_RUNTIME_HPP
+
+// Everything a generated program needs from the runtime. Header only except
+// for stdio.cpp, which the prebuilt runtime library holds.
+#include "langCPP.cpp"
+#include "stdio.hpp"
+
+#endif
@@ -1,56 +1,119 @@
+#include "runtime.hpp"
+
+OutputBuffer outputBuffer;
+
+// Emitted at the top of main, output() no longer goes through std::cout
+void setupIO() {
+  std::ios::sync_with_stdio(false);
+  std::cin.tie(nullptr);
+}
+
+void flush() {
+  outputBuffer.flush();
+}
+
 // Output //
 
 void output(const char* msg) {
-  std::cout << msg;
+  outputBuffer.write(msg, strlen(msg));
 }
 
-void output(Dynamic msg) {
-  std::cout << msg;
+void output(const Dynamic& msg) {
+  if (msg.type == msg.STRING)
+    outputBuffer.write(msg.view());
+  else if (msg.type == msg.INT)
+    outputBuffer.writeNumber(msg.num);
+  else if (msg.type == msg.DOUBLE)
+    outputBuffer.writeNumber(msg.flt);
+  else if (msg.type == msg.BIGINT)
+    outputBuffer.write(msg.big->toString());
+  else if (msg.type == msg.BOOL)
+    outputBuffer.write(msg.bln ? "True" : "False");
+  else if (msg.type == msg.LIST || msg.type == msg.MAP || msg.type == msg.ARRAY)
+    outputBuffer.write(msg.formatCollection());
 }
 
-void output(std::string msg) {
-  std::cout << msg;
+void output(const NumericArray& msg) {
+  outputBuffer.write(msg.toString());
 }
 
-void output(bool msg) {
-  std::string boolean = "False";
+void output(const std::string& msg) {
+  outputBuffer.write(msg);
+}
 
-  if (msg) boolean = "True";
+void output(std::string_view msg) {
+  outputBuffer.write(msg);
+}
 
-  std::cout << boolean;
+void output(bool msg) {
+  outputBuffer.write(msg ? "True" : "False");
 }
 
-void output(int msg) {
-  std::cout << msg;
+void output(double msg) {
+  outputBuffer.writeNumber(msg);
 }
 
-template<typename T, typename ... Args>
-void output(T arg, Args ...args) {
-  std::cout << arg;
+// Input Buffer //
+// stdin is scanned in place by a StreamReader. Pending output is flushed
+// before every blocking read, so prompts still show up without flushing
+// on each call.
 
-  output(args...);
-};
+StreamReader inputBuffer(STDIN_FILENO, false, flush);
 
 // Input //
 
+// Next whitespace separated token
 std::string input() {
-  std::string output;
+  return std::string(inputBuffer.token());
+}
 
-  std::cin >> output;
+std::string input(const char* msg) {
+  outputBuffer.write(msg, strlen(msg));
 
-  return output;
+  return input();
 }
 
-std::string input(const char* msg) {
-  std::string output;
+std::string input(std::string msg) {
+  return input(msg.c_str());
+}
 
-  std::cout << msg;
+// Empty once the input is exhausted, check hasInput() to tell it apart
+std::string inputLine() {
+  std::string_view text;
 
-  std::cin >> output;
+  if (!inputBuffer.line(text))
+    return "";
 
-  return output;
+  return std::string(text);
 }
 
-std::string input(std::string msg) {
-  return input(msg.c_str());
-}
\ No newline at end of file
+std::string inputAll() {
+  return std::string(inputBuffer.all());
+}
+
+bool hasInput() {
+  return inputBuffer.available();
+}
+
+// Next token as an INT, BIGINT or DOUBLE, or as a STRING if it isn't a number
+Dynamic inputNumber() {
+  std::string_view text = inputBuffer.token();
+  const char* first = text.data();
+  const char* last = text.data() + text.size();
+
+  long long integer;
+  auto parsed = std::from_chars(first, last, integer);
+
+  if (parsed.ptr == last && parsed.ec == std::errc())
+    return Dynamic(integer);
+  else if (parsed.ptr == last && parsed.ec == std::errc::result_out_of_range)
+    return Dynamic(Dynamic::BigInt::parse(text));
+
+  double number;
+  parsed = std::from_chars(first, last, number);
+
+  if (parsed.ptr == last && parsed.ec == std::errc())
+    return Dynamic(number);
+
+  return Dynamic(std::string(text));
+}
@@ -0,0 +1,118 @@
+#ifndef ADK_STDIO_HPP
+#define ADK_STDIO_HPP
+
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <unistd.h>
+
+// Declarations for stdio.cpp, which is compiled once into the runtime
+// library. Templates stay here since every program instantiates its own.
+
+// Output Buffer //
+// Everything output() prints is collected here and written to stdout in
+// large blocks. It's flushed when full, before input() reads, at exit, and
+// after every newline when stdout is a terminal so prompts still show up.
+
+class OutputBuffer {
+  public:
+
+  static const size_t CAPACITY = 1 << 16;
+
+  char data[CAPACITY];
+  size_t size = 0;
+  bool interactive;
+
+  OutputBuffer()
+    : interactive(isatty(fileno(stdout)))
+  {};
+
+  ~OutputBuffer() {
+    flush();
+  }
+
+  void flush() {
+    if (size > 0)
+      fwrite(data, 1, size, stdout);
+
+    size = 0;
+    fflush(stdout);
+  }
+
+  void write(const char* text, size_t length) {
+    if (length > CAPACITY - size) {
+      flush();
+
+      // Too big to be worth copying
+      if (length >= CAPACITY) {
+        fwrite(text, 1, length, stdout);
+        return;
+      }
+    }
+
+    memcpy(data + size, text, length);
+    size += length;
+
+    if (interactive && memchr(text, '\n', length))
+      flush();
+  }
+
+  void write(std::string_view text) {
+    write(text.data(), text.size());
+  }
+
+  // Formatted in place, without a stream or a temporary string
+  template<typename T>
+  void writeNumber(T value) {
+    char digits[32];
+    std::to_chars_result result;
+
+    if constexpr (std::is_floating_point_v<T>)
+      result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+    else
+      result = std::to_chars(digits, digits + sizeof(digits), value);
+
+    write(digits, result.ptr - digits);
+  }
+};
+
+extern OutputBuffer outputBuffer;
+extern StreamReader inputBuffer;
+
+void setupIO();
+void flush();
+
+// Output //
+
+void output(const char* msg);
+void output(const Dynamic& msg);
+void output(const NumericArray& msg);
+void output(const std::string& msg);
+void output(std::string_view msg);
+void output(bool msg);
+void output(double msg);
+
+template<typename T>
+IfInteger<T> output(T msg) {
+  outputBuffer.writeNumber(msg);
+}
+
+template<typename T, typename ... Args>
+void output(const T& arg, const Args& ...args) {
+  output(arg);
+
+  output(args...);
+};
+
+// Input //
+
+std::string input();
+std::string input(const char* msg);
+std::string input(std::string msg);
+std::string inputLine();
+std::string inputAll();
+bool hasInput();
+Dynamic inputNumber();
+
+#endif
@@ -36,4 +36,5 @@ const Warning = (errorname: string) => class extends ADKError {
 
 export const ADKSyntaxError = Warning("ADKSyntaxError");
 export const ADKInvalidCharacter = Warning("ADKInvalidCharacter");
-export const ADKFileNotFound = Warning("ADKFileNotFound");
\ No newline at end of file
+export const ADKFileNotFound = Warning("ADKFileNotFound");
+export const ADKBuildError = Warning("ADKBuildError");
\ No newline at end of file
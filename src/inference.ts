@@ -0,0 +1,550 @@
+import { Scope } from "./parser.ts";
+
+// C++ types the transpiler can emit for an ADK value
+export const Types = {
+  INT: "long long",
+  DOUBLE: "double",
+  STRING: "std::string",
+  BOOL: "bool",
+  ARRAY: "NumericArray",
+  DYNAMIC: "Dynamic"
+};
+
+// undefined means nothing is known yet, Dynamic means the value changes type
+export type InferredType = string | undefined;
+
+// One monomorphised clone of an ADK function, keyed on its argument types
+export interface FunctionSignature {
+  name: string;
+  args: string[];
+  returns: InferredType;
+}
+
+const comparisons = ["==", "!=", "<", ">", "<=", ">="];
+
+// Runtime and module functions whose result type is known up front
+const builtins: { [name: string]: string } = {
+  array: Types.ARRAY,
+  zeros: Types.ARRAY,
+  arange: Types.ARRAY,
+  range: Types.ARRAY,
+  randints: Types.ARRAY,
+  randnums: Types.ARRAY,
+  AliasTable: "AliasTable"
+};
+
+// Past this many clones a function falls back to its all-Dynamic version
+const MAX_SIGNATURES = 8;
+
+// Runtime TYPES bits of a type profile that a guard can unbox to a native type
+const GUARDABLE: { [mask: number]: string } = {
+  2: Types.INT,
+  4: Types.DOUBLE,
+  8: Types.BOOL
+};
+
+export default class TypeInference {
+  variables: Map<string, InferredType>;
+  functions: Map<string, any>;
+  locals: Map<string, Set<string>>;
+
+  signatures: Map<string, FunctionSignature>;
+  roots: Set<string>;
+  used: Set<string>;
+
+  changed: boolean;
+
+  // Types each probed call argument held in a training run, by site
+  profile: Map<string, number>;
+
+  constructor(profile: Map<string, number> = new Map) {
+    this.profile = profile;
+    this.variables = new Map;
+    this.functions = new Map;
+    this.locals = new Map([["main", new Set]]);
+
+    this.signatures = new Map;
+    this.roots = new Set;
+    this.used = new Set;
+
+    this.changed = false;
+  }
+
+  static join(a: InferredType, b: InferredType): InferredType {
+    if (a === undefined) return b;
+    if (b === undefined) return a;
+
+    return a == b ? a : Types.DYNAMIC;
+  }
+
+  static isNumeric(type: InferredType): boolean {
+    return type == Types.INT || type == Types.DOUBLE;
+  }
+
+  static isNative(type: InferredType): boolean {
+    return type !== undefined && type != Types.DYNAMIC;
+  }
+
+  // Whether a block always ends in a return, every branch of a final if included
+  static alwaysReturns(statements: any[]): boolean {
+    const last = statements[statements.length - 1];
+
+    if (last?.type == "Return") return true;
+    if (last?.type != "If" || !last.value.else) return false;
+
+    const branch = (exp: any) => exp.type == "Scope" ? exp.block : [exp];
+    return TypeInference.alwaysReturns(last.value.then.block) && TypeInference.alwaysReturns(branch(last.value.else));
+  }
+
+  // `for x in file.lines()` or `file.chunks(size)`, streamed as strings
+  static isStream(iterable: any): boolean {
+    const call = iterable?.type == "Identifier" ? iterable.dotOp : undefined;
+    return call?.type == "FunctionCall" && !call.value.dotOp && ["lines", "chunks"].includes(call.value.name.value);
+  }
+
+  // `for i in range(...)` with the runtime's range, which can become a counted loop
+  static isRange(exp: any, functions: Map<string, any>): boolean {
+    return exp?.type == "FunctionCall" && exp.value.name.value == "range" && !exp.value.dotOp
+      && !functions.has("range") && exp.value.args.length >= 1 && exp.value.args.length <= 3;
+  }
+
+  // Names a call argument the same way in every build of a program
+  static site(scope: string, exp: any, index: number): string {
+    return `${scope}@${exp.value.name.line}:${exp.value.name.index}#${index}`;
+  }
+
+  // Dynamic variables passed to a function that can be checked for their
+  // type and unboxed at the call, the ones a type profile could specialise
+  probeable(exp: any, scope: string): number[] {
+    const { name, args } = exp.value;
+    if (!this.functions.has(name.value) || exp.value.dotOp) return [];
+
+    return args
+      .map((arg: any, index: number) => arg?.type == "Identifier" && !arg.dotOp && this.typeOf(arg, scope) == Types.DYNAMIC ? index : -1)
+      .filter((index: number) => index != -1);
+  }
+
+  // Argument types of the clone a call is specialised to when the profile
+  // saw its Dynamic arguments always hold one native type
+  guardedTypes(exp: any, scope: string): string[] | undefined {
+    const signature = this.signatureOf(exp, scope);
+    if (!signature) return;
+
+    const types = [...signature.args];
+    let guarded = false;
+
+    for (const index of this.probeable(exp, scope)) {
+      const type = GUARDABLE[this.profile.get(TypeInference.site(scope, exp, index)) ?? 0];
+
+      if (type && index < types.length) {
+        types[index] = type;
+        guarded = true;
+      }
+    }
+
+    return guarded ? types : undefined;
+  }
+
+  static signatureKey(name: string, args: string[]): string {
+    return `${name}(${args.join(", ")})`;
+  }
+
+  // Int constant small enough that counting by it, like `i + 1`, can't overflow in practice
+  static isSmallStep(exp: any): boolean {
+    return exp?.type == "Number" && Number.isSafeInteger(exp.value) && Math.abs(exp.value) <= 0xFFFF;
+  }
+
+  // Type of `left op right`, mirroring what the Dynamic operators would produce.
+  // operands are the expressions on each side, when they're known
+  static binaryType(op: string, left: InferredType, right: InferredType, operands: any[] = []): InferredType {
+    if (left === undefined || right === undefined) return undefined;
+
+    // Numeric arrays combine elementwise with arrays and numbers, comparisons included
+    if (left == Types.ARRAY || right == Types.ARRAY) {
+      const operand = (type: InferredType) => type == Types.ARRAY || TypeInference.isNumeric(type);
+      const elementwise = ["+", "-", "*", "/", ...comparisons].includes(op);
+
+      return elementwise && operand(left) && operand(right) ? Types.ARRAY : Types.DYNAMIC;
+    }
+
+    if (comparisons.includes(op)) return Types.BOOL;
+    if (left == Types.DYNAMIC || right == Types.DYNAMIC) return Types.DYNAMIC;
+
+    if (left == right && TypeInference.isNumeric(left)) {
+      if (op == "%" && left == Types.DOUBLE) return Types.DYNAMIC;
+
+      // Native ints can't promote to a bigint, so products and sums that
+      // could outgrow 64 bits (fact(n - 1) * n, a + b) stay Dynamic
+      if (left == Types.INT && (op == "*" || (op == "+" || op == "-") && !operands.some(TypeInference.isSmallStep)))
+        return Types.DYNAMIC;
+
+      return left;
+    }
+
+    if (op == "+") {
+      const textual = (type: InferredType) => type == Types.STRING || TypeInference.isNumeric(type);
+
+      if ((left == Types.STRING || right == Types.STRING) && textual(left) && textual(right))
+        return Types.STRING;
+    }
+
+    return Types.DYNAMIC;
+  }
+
+  // Proves the type of every variable, parameter and return value it can,
+  // cloning each function once per distinct tuple of argument types
+  infer(ast: Scope): TypeInference {
+    this.collect(ast, "main");
+    this.solve(ast);
+    this.reach(ast);
+
+    // Functions nobody calls are still emitted, fully Dynamic
+    const uncalled = [...this.functions.keys()]
+      .filter((name) => ![...this.used].some((key) => this.signatures.get(key)?.name == name));
+
+    if (uncalled.length > 0) {
+      for (const name of uncalled) {
+        const args = this.functions.get(name).value.parameters.map(() => Types.DYNAMIC);
+
+        this.specialise(name, args);
+        this.roots.add(TypeInference.signatureKey(name, args));
+      }
+
+      this.solve(ast);
+      this.reach(ast);
+    }
+
+    return this;
+  }
+
+  solve(ast: Scope) {
+    do {
+      do {
+        this.changed = false;
+        this.visit(ast, "main");
+
+        for (const [key, signature] of [...this.signatures]) {
+          const body = this.functions.get(signature.name).value.scope;
+          this.visit(body, key);
+
+          // Falling off the end returns an empty Dynamic
+          if (!TypeInference.alwaysReturns(body.block) && signature.returns != Types.DYNAMIC) {
+            signature.returns = Types.DYNAMIC;
+            this.changed = true;
+          }
+        }
+      } while (this.changed);
+
+      this.close();
+    } while (this.changed);
+  }
+
+  // Anything still unknown once nothing else changes can only be a Dynamic
+  close() {
+    for (const [key, type] of this.variables) {
+      if (type === undefined) this.setVariable(key, Types.DYNAMIC);
+    }
+
+    for (const signature of this.signatures.values()) {
+      if (signature.returns === undefined) {
+        signature.returns = Types.DYNAMIC;
+        this.changed = true;
+      }
+    }
+  }
+
+  // Marks the clones that are actually called from main, or kept as roots
+  reach(ast: Scope) {
+    this.used = new Set;
+    this.markCalls(ast, "main");
+
+    for (const key of this.roots) this.markUsed(key);
+  }
+
+  markUsed(key: string) {
+    const signature = this.signatures.get(key);
+    if (!signature || this.used.has(key)) return;
+
+    this.used.add(key);
+    this.markCalls(this.functions.get(signature.name).value.scope, key);
+  }
+
+  markCalls(exp: any, scope: string) {
+    if (!exp || typeof exp != "object") return;
+
+    if (exp.type == "FunctionCall") {
+      const signature = this.signatureOf(exp, scope);
+      const guarded = this.guardedTypes(exp, scope);
+
+      if (signature) this.markUsed(TypeInference.signatureKey(signature.name, signature.args));
+      if (guarded) this.markUsed(TypeInference.signatureKey(exp.value.name.value, guarded));
+    }
+
+    if (exp.type == "Function") return;
+
+    for (const value of Object.values(exp)) {
+      if (Array.isArray(value)) value.forEach((item) => this.markCalls(item, scope));
+      else this.markCalls(value, scope);
+    }
+  }
+
+  // Registers every function and every name assigned to, per function
+  collect(exp: any, scope: string) {
+    if (!exp || typeof exp != "object") return;
+
+    switch (exp.type) {
+      case "Scope":
+        for (const stmt of exp.block) this.collect(stmt, scope);
+        break;
+
+      case "Function": {
+        const name = exp.value.name.value;
+
+        this.functions.set(name, exp);
+        this.locals.set(name, new Set(exp.value.parameters.map((param: any) => param.value)));
+        this.collect(exp.value.scope, name);
+        break;
+      }
+
+      // Storing into a list or map element doesn't declare anything
+      case "Assign":
+        if (exp.left.type != "Index") this.locals.get(scope)?.add(exp.left.value);
+        break;
+
+      case "If":
+        this.collect(exp.value.then, scope);
+        this.collect(exp.value.else, scope);
+        break;
+
+      case "ForLoop":
+        this.locals.get(scope)?.add(exp.value.variable.value);
+        this.collect(exp.value.scope, scope);
+        break;
+
+      case "WhileLoop":
+        this.collect(exp.value.scope, scope);
+        break;
+    }
+  }
+
+  // Function (or main) a variable scope belongs to
+  scopeName(scope: string): string {
+    return this.signatures.get(scope)?.name ?? scope;
+  }
+
+  isLocal(scope: string, name: string): boolean {
+    return this.locals.get(this.scopeName(scope))?.has(name) ?? false;
+  }
+
+  setVariable(key: string, type: InferredType) {
+    const old = this.variables.get(key);
+    const joined = TypeInference.join(old, type);
+
+    if (!this.variables.has(key) || joined !== old) {
+      this.variables.set(key, joined);
+      this.changed = true;
+    }
+  }
+
+  specialise(name: string, args: string[]): FunctionSignature {
+    let key = TypeInference.signatureKey(name, args);
+
+    if (!this.signatures.has(key)) {
+      const count = [...this.signatures.values()].filter((signature) => signature.name == name).length;
+
+      if (count >= MAX_SIGNATURES) {
+        args = args.map(() => Types.DYNAMIC);
+        key = TypeInference.signatureKey(name, args);
+      }
+    }
+
+    if (!this.signatures.has(key)) {
+      const parameters = this.functions.get(name).value.parameters;
+
+      this.signatures.set(key, { name, args, returns: undefined });
+      parameters.forEach((param: any, index: number) => this.setVariable(`${key}:${param.value}`, args[index]));
+
+      this.changed = true;
+    }
+
+    return this.signatures.get(key) as FunctionSignature;
+  }
+
+  // Clone a call resolves to, undefined while its argument types are unknown
+  signatureOf(exp: any, scope: string): FunctionSignature | undefined {
+    const { name, args } = exp.value;
+    const fn = this.functions.get(name.value);
+    if (!fn || exp.value.dotOp) return;
+
+    const types = fn.value.parameters.map((param: any, index: number) => index < args.length
+      ? this.typeOf(args[index], scope)
+      : Types.DYNAMIC);
+
+    if (types.includes(undefined)) return;
+
+    const key = TypeInference.signatureKey(name.value, types);
+    if (this.signatures.has(key)) return this.signatures.get(key);
+
+    return this.signatures.get(TypeInference.signatureKey(name.value, types.map(() => Types.DYNAMIC)));
+  }
+
+  visit(exp: any, scope: string) {
+    if (!exp || typeof exp != "object") return;
+
+    switch (exp.type) {
+      case "Scope":
+        for (const stmt of exp.block) this.visit(stmt, scope);
+        break;
+
+      case "Assign": {
+        if (exp.left.type == "Index") {
+          this.visit(exp.left, scope);
+          this.visit(exp.right, scope);
+          break;
+        }
+
+        const key = `${scope}:${exp.left.value}`;
+        const type = exp.op == "="
+          ? this.typeOf(exp.right, scope)
+          : TypeInference.binaryType(exp.op.replace("=", ""), this.variables.get(key), this.typeOf(exp.right, scope), [exp.left, exp.right]);
+
+        this.setVariable(key, type);
+        this.visit(exp.right, scope);
+        break;
+      }
+
+      case "Binary":
+        this.visit(exp.left, scope);
+        this.visit(exp.right, scope);
+        break;
+
+      case "Return": {
+        const signature = this.signatures.get(scope);
+
+        if (signature) {
+          const joined = TypeInference.join(signature.returns, this.typeOf(exp.value, scope));
+
+          if (joined !== signature.returns) {
+            signature.returns = joined;
+            this.changed = true;
+          }
+        }
+
+        this.visit(exp.value, scope);
+        break;
+      }
+
+      case "If":
+        this.visit(exp.value.condition, scope);
+        this.visit(exp.value.then, scope);
+        this.visit(exp.value.else, scope);
+        break;
+
+      // lines() and chunks() stream strings, a range of ints counts with an
+      // int, anything else is looped over as a Dynamic (list items, map
+      // keys, characters or file lines)
+      case "ForLoop": {
+        const { variable, iterable } = exp.value;
+        let type: InferredType = TypeInference.isStream(iterable) ? Types.STRING : Types.DYNAMIC;
+
+        if (TypeInference.isRange(iterable, this.functions)) {
+          const bounds = iterable.value.args.map((arg: any) => this.typeOf(arg, scope));
+
+          if (bounds.includes(undefined)) type = undefined;
+          else if (bounds.every((bound: InferredType) => bound == Types.INT)) type = Types.INT;
+        }
+
+        this.setVariable(`${scope}:${variable.value}`, type);
+        this.visit(iterable, scope);
+        this.visit(exp.value.scope, scope);
+        break;
+      }
+
+      case "WhileLoop":
+        this.visit(exp.value.condition, scope);
+        this.visit(exp.value.scope, scope);
+        break;
+
+      case "List":
+        for (const item of exp.value) this.visit(item, scope);
+        break;
+
+      case "Map":
+        for (const { key, value } of exp.value) {
+          this.visit(key, scope);
+          this.visit(value, scope);
+        }
+        break;
+
+      case "Index":
+        this.visit(exp.value.target, scope);
+        this.visit(exp.value.index, scope);
+        break;
+
+      case "FunctionCall": {
+        const { name, args } = exp.value;
+        const fn = this.functions.get(name.value);
+
+        if (fn && !exp.value.dotOp) {
+          const types = fn.value.parameters.map((param: any, index: number) => index < args.length
+            ? this.typeOf(args[index], scope)
+            : Types.DYNAMIC);
+
+          if (!types.includes(undefined)) this.specialise(name.value, types);
+
+          const guarded = this.guardedTypes(exp, scope);
+          if (guarded) this.specialise(name.value, guarded);
+        }
+
+        for (const arg of args) this.visit(arg, scope);
+        break;
+      }
+    }
+  }
+
+  typeOf(exp: any, scope: string): InferredType {
+    if (!exp || typeof exp != "object") return Types.DYNAMIC;
+
+    switch (exp.type) {
+      case "Number":
+        return Number.isSafeInteger(exp.value) ? Types.INT : Types.DOUBLE;
+
+      case "String":
+        return Types.STRING;
+
+      case "Boolean":
+        return Types.BOOL;
+
+      case "Identifier": {
+        if (exp.dotOp || !this.isLocal(scope, exp.value)) return Types.DYNAMIC;
+        return this.variables.get(`${scope}:${exp.value}`);
+      }
+
+      case "Assign":
+        return this.typeOf(exp.right, scope);
+
+      case "Binary":
+        return TypeInference.binaryType(exp.op, this.typeOf(exp.left, scope), this.typeOf(exp.right, scope), [exp.left, exp.right]);
+
+      case "FunctionCall": {
+        const name = exp.value.name.value;
+
+        if (!exp.value.dotOp && !this.functions.has(name) && builtins[name]) return builtins[name];
+        if (exp.value.dotOp || !this.functions.has(name)) return Types.DYNAMIC;
+        return this.signatureOf(exp, scope)?.returns;
+      }
+    }
+
+    return Types.DYNAMIC;
+  }
+
+  // Final C++ type of a variable in a scope
+  variableType(scope: string, name: string): string {
+    return this.variables.get(`${scope}:${name}`) ?? Types.DYNAMIC;
+  }
+
+  // Clones of a function that the program actually needs, in creation order
+  usedSignatures(name: string): [string, FunctionSignature][] {
+    return [...this.signatures].filter(([key, signature]) => signature.name == name && this.used.has(key));
+  }
+}
@@ -1,17 +1,142 @@
 import { Token, LexerGrammar } from "./types.ts";
 import { ADKInvalidCharacter } from "./errors.ts";
 
+// Character classes, a bit set per ASCII code
+const WHITESPACE = 1 << 0;
+const DIGIT = 1 << 1;
+const LETTER = 1 << 2;
+const SPECIAL = 1 << 3;
+const STRING = 1 << 4;
+const DELIMITER = 1 << 5;
+const BINOPERATOR = 1 << 6;
+const OPERATOR = 1 << 7; // Starts an operator
+
+const IDENTIFIER = LETTER | DIGIT | SPECIAL;
+
+const LINEBREAK = 10; // "\n"
+const HASH = 35; // "#"
+const DOT = 46; // "."
+const SNIPPET = "```";
+
+// Everything the lexer asks of a grammar, worked out once per grammar
+interface CompiledGrammar {
+	classes: Uint8Array;
+	chars: string[]; // Single character tokens as strings, so they're never sliced
+
+	// Operators by first character, longest first
+	operators: Map<number, string[]>;
+
+	// Perfect hash of every word that isn't an identifier
+	words: (string | undefined)[];
+	wordTypes: string[];
+	wordSeed: number;
+	wordMask: number;
+};
+
+const compiled: WeakMap<LexerGrammar, CompiledGrammar> = new WeakMap;
+
+function hashWord(text: string, start: number, end: number, seed: number): number {
+	let hash = seed;
+
+	for (let i = start; i < end; i++)
+		hash = Math.imul(hash ^ text.charCodeAt(i), 16777619);
+
+	return hash ^ (hash >>> 15);
+}
+
+// Smallest table and a seed that give every word its own slot
+function perfectHash(words: string[]): { table: (string | undefined)[], seed: number, mask: number } {
+	for (let size = 16; ; size *= 2) {
+		if (size < words.length * 2) continue;
+
+		for (let seed = 1; seed < 4096; seed++) {
+			const table: (string | undefined)[] = new Array(size);
+			const mask = size - 1;
+
+			const fits = words.every((word) => {
+				const slot = hashWord(word, 0, word.length, seed) & mask;
+				if (table[slot] !== undefined) return false;
+
+				table[slot] = word;
+				return true;
+			});
+
+			if (fits) return { table, seed, mask };
+		}
+	}
+}
+
+function compile(grammar: LexerGrammar): CompiledGrammar {
+	const classes = new Uint8Array(128);
+	const chars: string[] = [];
+
+	const mark = (list: Iterable<string>, type: number) => {
+		for (const char of list) {
+			const code = char.charCodeAt(0);
+
+			if (code < 128) {
+				classes[code] |= type;
+				chars[code] = char;
+			}
+		}
+	};
+
+	for (let code = 0; code < 128; code++) {
+		if (/[a-zA-Z]/.test(String.fromCharCode(code))) classes[code] |= LETTER;
+	}
+
+	mark(grammar.Whitespace, WHITESPACE);
+	mark(grammar.Digits, DIGIT);
+	mark(grammar.Special, SPECIAL);
+	mark(grammar.Strings, STRING);
+	mark(grammar.Delimiters, DELIMITER);
+	mark(grammar.BinOperators.filter((op) => op.length == 1), BINOPERATOR);
+
+	const operators: Map<number, string[]> = new Map;
+
+	for (const op of grammar.Operators) {
+		const code = op.charCodeAt(0);
+
+		if (code < 128) classes[code] |= OPERATOR;
+		operators.set(code, [...operators.get(code) ?? [], op].sort((a, b) => b.length - a.length));
+	}
+
+	// Later lists win, like the checks they replace
+	const types: Map<string, string> = new Map;
+
+	for (const word of [...grammar.Operators, ...grammar.BinOperators]) types.set(word, "Operator");
+	for (const word of grammar.Keywords) types.set(word, "Keyword");
+	for (const word of grammar.Datatypes) types.set(word, "Datatype");
+
+	const { table, seed, mask } = perfectHash([...types.keys()]);
+
+	return {
+		classes,
+		chars,
+		operators,
+
+		words: table,
+		wordTypes: table.map((word) => word === undefined ? "" : types.get(word) as string),
+		wordSeed: seed,
+		wordMask: mask
+	};
+}
+
+// Single pass over the input. Characters are classified by a lookup table,
+// words are told apart from identifiers by a perfect hash, and tokens point
+// into the source (start, end) with a value that's only sliced out when it
+// isn't one of the grammar's own strings.
 export default class Lexer {
 	input!: string;
 	filepath!: string;
 	grammar!: LexerGrammar;
+	compiled!: CompiledGrammar;
 
 	tokens: Token[] = [];
-	char!: string;
 
 	pos = 0;
-	index = 0;
 	line = 1;
+	lineStart = 0; // Offset of the current line, index is the column
 
 	constructor(
 		input: string,
@@ -22,341 +147,172 @@ export default class Lexer {
 			this, {
 				input,
 				filepath,
-				grammar,
-
-				char: input[0]
+				grammar
 			}
 		);
 	}
 
-	skip(num = 1): string {
-		return this.char = this.input[this.pos += num];
-	}
-
-	advance(num = 1) {
-		this.index += num;
-		return this.char = this.input[this.pos += num];
-	}
-
-	peek(num = 1) {
-		return this.input[this.pos + num];
-	}
-
-	isWhitespace(char = this.char) {
-		return this.grammar.Whitespace.includes(char);
-	}
-
-	isLinebreak(char = this.char) {
-		return char === '\n';
+	get index(): number {
+		return this.pos - this.lineStart;
 	}
 
-	isLetter(char = this.char): boolean {
-		return /[a-zA-Z]/.test(char);
+	push(type: string, value: any, start: number, end: number, line = this.line, index = start - this.lineStart) {
+		this.tokens.push({ type, value, index, line, start, end });
 	}
 
-	isNumber(char = this.char) {
-		return char === "-"
-			&& this.grammar.Digits.includes(this.peek())
-			|| this.grammar.Digits.includes(char);
-	}
+	// Moves to end, counting the lines in between
+	skipTo(end: number) {
+		const { input } = this;
+		let newline = input.indexOf("\n", this.pos);
 
-	isString(char = this.char) {
-		return this.grammar.Strings.includes(char);
-	}
-
-	isOperator(char = this.char) {
-		return (
-			this.grammar.Operators.includes(char)
-			|| this.grammar.Operators.includes(char + this.peek())
-			|| this.grammar.Operators.includes(char + this.peek() + this.peek())
-		);
-	}
-
-	isBinOperator(char = this.char) {
-		return this.grammar.BinOperators.includes(char);
-	}
+		while (newline != -1 && newline < end) {
+			++this.line;
+			this.lineStart = newline + 1;
+			newline = input.indexOf("\n", newline + 1);
+		}
 
-	isDelimiter(char = this.char) {
-		return this.grammar.Delimiters.includes(char);
+		this.pos = end;
 	}
 
-	isSpecial(special?: string, char = this.char) {
-		if (special)
-			return this.grammar.Special.includes(special) && (char == special);
-		return this.grammar.Special.includes(char);
+	// Offset of the next `text` from start, or the end of the input
+	find(text: string, start: number): number {
+		const found = this.input.indexOf(text, start);
+		return found == -1 ? this.input.length : found;
 	}
 
-	isIdentifier(char = this.char) {
-		return this.isLetter(char)
-			|| this.isNumber(char)
-			|| this.isSpecial(char);
-	}
+	// Datatype, Keyword or Operator for a word of the grammar, else an Identifier
+	word(start: number, end: number): [string, string] {
+		const { input } = this;
+		const { words, wordTypes, wordSeed, wordMask } = this.compiled;
 
-	isSnippet(char = this.char) {
-		return char === '`'
-			&& this.peek() === '`'
-			&& this.peek(2) === '`';
-	}
+		const slot = hashWord(input, start, end, wordSeed) & wordMask;
+		const word = words[slot];
 
-	isInlineComment(char = this.char) {
-		let i = 0;
-		let str = "";
-		const { InlineComment } = this.grammar;
-		for (const letter of InlineComment) {
-			if (letter === this.peek(i)) {
-				str += letter;
-				++i;
-			}
-		}
+		if (word !== undefined && word.length == end - start && input.startsWith(word, start))
+			return [wordTypes[slot], word];
 
-		return {
-			match: str === InlineComment,
-			length: InlineComment.length
-		};
+		return ["Identifier", input.slice(start, end)];
 	}
 
-	isBlockComment(index = 0) {
-		let i = 0;
-		let str = "";
-		for (const letter of this.grammar.BlockComment[index]) {
-			if (letter === this.peek(i)) {
-				str += letter;
-				++i;
-			}
-		}
+	tokenize(): Token[] {
+		if (!compiled.has(this.grammar)) compiled.set(this.grammar, compile(this.grammar));
+		this.compiled = compiled.get(this.grammar) as CompiledGrammar;
 
-		const temp = this.grammar.BlockComment[index];
+		const { input, grammar } = this;
+		const { classes, chars, operators } = this.compiled;
+		const { length } = input;
 
-		return {
-			match: str === temp,
-			length: temp.length
+		const [blockStart, blockEnd] = grammar.BlockComment;
+		const classOf = (pos: number) => {
+			const code = input.charCodeAt(pos);
+			return code < 128 ? classes[code] : 0;
 		};
-	}
 
-	tokenize(): Token[] {
-		while (this.char != undefined) {
-			const lastPos = this.pos;
-
-			if (this.isLinebreak()) {
-				if (!this.isWhitespace()) {
-					this.tokens.push({
-						type: "Linebreak",
-						value: "\n",
-						index: this.index,
-						line: this.line
-					});
-				}
+		while (this.pos < length) {
+			const start = this.pos;
+			const code = input.charCodeAt(start);
+			const type = code < 128 ? classes[code] : 0;
 
-				this.advance();
+			if (code == LINEBREAK && !(type & WHITESPACE)) {
+				this.push("Linebreak", "\n", start, start + 1);
 
-				++this.line;
-				this.index = 0;
+				this.pos++;
+				this.line++;
+				this.lineStart = this.pos;
+				continue;
 			}
 
-			if (this.isWhitespace()) {
-				this.advance();
+			if (type & WHITESPACE) {
+				this.pos++;
+				continue;
 			}
 
-			if (this.isSnippet()) {
-				this.advance(3);
-				let code = "";
-
-				while (this.char != null && !this.isSnippet()) {
-					code += this.char;
-					this.advance();
-				}
+			if (input.startsWith(SNIPPET, start)) {
+				const end = this.find(SNIPPET, start + SNIPPET.length);
+				const { line, index } = this;
 
-				this.tokens.push({
-					type: "CPPSnippet",
-					value: code,
-					index: this.index,
-					line: this.line
-				});
-				this.advance(3);
+				this.skipTo(Math.min(end + SNIPPET.length, length));
+				this.push("CPPSnippet", input.slice(start + SNIPPET.length, end), start, this.pos, line, index);
+				continue;
 			}
 
-			if (this.isInlineComment().match) {
-				const { length } = this.isInlineComment();
-
-				this.skip(length);
-
-				while (this.char != null && !this.isLinebreak()) {
-					this.skip();
-				}
+			if (input.startsWith(grammar.InlineComment, start)) {
+				this.pos = this.find("\n", start);
+				continue;
 			}
 
-			if (this.isBlockComment().match) {
-				const lengthStart = this.isBlockComment().length;
-
-				const lengthEnd = this.isBlockComment(1).length;
-
-				this.advance(lengthStart);
-
-				while (this.char != null && !this.isBlockComment(1).match) {
-					this.advance();
-				}
-
-				this.advance(lengthEnd);
+			if (input.startsWith(blockStart, start)) {
+				this.skipTo(Math.min(this.find(blockEnd, start + blockStart.length) + blockEnd.length, length));
+				continue;
 			}
 
-			if (this.isSpecial("#")) {
-				let value = "";
-				const index = this.index;
-				const line = this.line;
-				value += this.advance();
+			// The directive is everything after the # up to the end of the line
+			if (code == HASH && type & SPECIAL) {
+				const end = this.find("\n", start);
 
-				while (this.char !== undefined && !this.isLinebreak()) {
-					const char = this.advance();
-					if (char !== undefined && !this.isLinebreak())
-						value += char;
-				}
-
-				this.tokens.push({
-					type: "Directive",
-					value,
-					index,
-					line
-				});
+				this.push("Directive", input.slice(start + 1, end), start, end);
+				this.pos = end;
+				continue;
 			}
 
-			if (this.isOperator()) {
-				const {
-					index,
-					line
-				} = this;
-
+			if (type & OPERATOR) {
+				const op = (operators.get(code) as string[]).find((op) => input.startsWith(op, start));
 
-				let op = this.char;
-
-				while (this.isOperator(op + this.peek()) && this.char != null) {
-					this.advance();
-					op += this.char;
+				if (op !== undefined) {
+					this.push("Operator", op, start, start + op.length);
+					this.pos += op.length;
+					continue;
 				}
-
-				this.tokens.push({
-					type: "Operator",
-					value: op,
-					index,
-					line
-				});
-
-				this.advance();
-			} else if (this.isBinOperator()) {
-				this.tokens.push({
-					type: "BinOperator",
-					value: this.char,
-					index: this.index,
-					line: this.line
-				});
-
-				this.advance();
 			}
 
-			if (this.isNumber()) {
-				let str = this.char;
-				const {
-					index,
-					line
-				} = this;
-
-				this.advance();
-
-				while (this.char != null && this.isNumber()) {
-					str += this.char;
-					this.advance();
-				}
-
-				if (this.char == "." && this.isNumber(this.peek())) {
-					str += this.char;
-					this.advance();
-					while (this.char != null && this.isNumber()) {
-						str += this.char;
-						this.advance();
-					}
-				}
-
-				this.tokens.push({
-					type: "Number",
-					value: Number.parseFloat(str),
-					index,
-					line
-				});
+			if (type & BINOPERATOR) {
+				this.push("BinOperator", chars[code], start, start + 1);
+				this.pos++;
+				continue;
 			}
 
-			if (this.isString()) {
-				let value = "";
-				let {
-					index,
-					line
-				} = this;
-
-				this.advance();
+			if (type & DIGIT) {
+				let end = start + 1;
+				while (end < length && classOf(end) & DIGIT) end++;
 
-				while (this.char != null && !this.isString()) {
-					value += this.char;
-					this.advance();
+				if (input.charCodeAt(end) == DOT && classOf(end + 1) & DIGIT) {
+					end++;
+					while (end < length && classOf(end) & DIGIT) end++;
 				}
 
-				this.tokens.push({
-					type: "String",
-					value,
-					index,
-					line
-				});
-
-				this.advance();
+				this.push("Number", Number.parseFloat(input.slice(start, end)), start, end);
+				this.pos = end;
+				continue;
 			}
 
-			if (this.isDelimiter()) {
-				this.tokens.push({
-					type: "Delimiter",
-					value: this.char,
-					index: this.index,
-					line: this.line
-				});
+			// Closed by the quote it was opened with
+			if (type & STRING) {
+				const end = this.find(chars[code], start + 1);
+				const { line, index } = this;
 
-				this.advance();
+				this.skipTo(Math.min(end + 1, length));
+				this.push("String", input.slice(start + 1, end), start, this.pos, line, index);
+				continue;
 			}
 
-			if (this.isLetter()) {
-        if (this.char === undefined) break;
+			if (type & DELIMITER) {
+				this.push("Delimiter", chars[code], start, start + 1);
+				this.pos++;
+				continue;
+			}
 
-				let value = "";
-				const {
-					index,
-					line
-				} = this;
+			if (type & LETTER) {
+				let end = start + 1;
+				while (end < length && classOf(end) & IDENTIFIER) end++;
 
-				while (this.char != null && this.isIdentifier()) {
-					value += this.char;
-					this.advance();
-				}
+				const [wordType, value] = this.word(start, end);
 
-				const type =
-					this.grammar.Datatypes.includes(value)
-						? "Datatype"
-						: (this.grammar.Keywords.includes(value)
-							? "Keyword"
-							: (this.isOperator(value)
-								? "Operator"
-								: (this.isBinOperator(value)
-									? "Operator"
-									: "Identifier"
-								)
-							)
-						);
-
-				this.tokens.push({
-					type,
-					value,
-					index,
-					line
-				});
+				this.push(wordType, value, start, end);
+				this.pos = end;
+				continue;
 			}
 
-			if (lastPos == this.pos) {
-				new ADKInvalidCharacter(`Invalid character '${this.char}' at line ${this.line}, index ${this.index}`);
-			}
+			new ADKInvalidCharacter(`Invalid character '${input[start]}' at line ${this.line}, index ${this.index}`);
 		}
 
 		this.tokens.push({
@@ -368,4 +324,4 @@ export default class Lexer {
 
 		return this.tokens;
 	}
-};
\ No newline at end of file
+};
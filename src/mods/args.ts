@@ -54,7 +54,7 @@ export default function formatArgs(argv: string[]): Args {
 
   for (const arg of argv) {
     let value: string = "1";
-    if (arg.includes("=")) value = arg.split("=")[1];
+    if (arg.includes("=")) value = arg.slice(arg.indexOf("=") + 1);
     else if (!arg.includes("--")) value = arg;
 
     args.addArg(arg.replace(/=.*/, ""), value);
@@ -0,0 +1,112 @@
+import * as Path from "https://deno.land/std/path/mod.ts";
+import { exists, resolve } from "./fs.ts";
+
+const decode = TextDecoder.prototype.decode.bind(new TextDecoder);
+const encode = TextEncoder.prototype.encode.bind(new TextEncoder);
+
+// Everything besides the program that decides what C++ comes out
+const TOOLCHAIN = ["./index.ts", "./src"];
+
+// Hex SHA-256 of text or bytes
+export async function hash(data: string | Uint8Array): Promise<string> {
+  const bytes = typeof data == "string" ? encode(data) : data;
+  const digest = new Uint8Array(await crypto.subtle.digest("SHA-256", bytes));
+
+  return [...digest].map((byte) => byte.toString(16).padStart(2, "0")).join("");
+}
+
+async function hashFile(fileName: string): Promise<string | undefined> {
+  if (!await exists(fileName)) return;
+  return hash(await Deno.readFile(fileName));
+}
+
+// Every file under a path, sorted so the order never changes a hash
+async function listFiles(path: string): Promise<string[]> {
+  const stats = await Deno.lstat(path);
+  if (!stats.isDirectory) return [path];
+
+  const files: string[] = [];
+
+  for await (const entry of Deno.readDir(path))
+    files.push(...await listFiles(Path.join(path, entry.name)));
+
+  return files.sort();
+}
+
+// Content-addressed store of generated C++ and the binaries built from it.
+// An entry's key hashes the program, the grammar, the flags that change the
+// output and every compiler, runtime and module file, so nothing needs to be
+// invalidated by hand. Files pulled in with #include are only known after a
+// build, so each entry lists them with their hashes and a lookup checks them.
+export default class BuildCache {
+  dir: string;
+  toolchain?: string;
+
+  constructor(dir?: string) {
+    this.dir = dir ?? Deno.env.get("ADK_CACHE") ?? resolve("./.cache");
+  }
+
+  // Hash of the compiler, runtime and modules, read once per process
+  async toolchainHash(): Promise<string> {
+    if (this.toolchain) return this.toolchain;
+
+    const parts: string[] = [];
+
+    for (const root of TOOLCHAIN) {
+      for (const file of await listFiles(resolve(root)))
+        parts.push(file.slice(resolve("./").length), await hashFile(file) as string);
+    }
+
+    this.toolchain = await hash(parts.join("\0"));
+    return this.toolchain;
+  }
+
+  async key(inputs: string[]): Promise<string> {
+    return hash([await this.toolchainHash(), ...inputs].join("\0"));
+  }
+
+  // Generated C++ for a key, undefined when it was never built or an
+  // included file has changed since
+  async lookup(key: string): Promise<string | undefined> {
+    const manifest = Path.join(this.dir, `${key}.json`);
+    const source = Path.join(this.dir, `${key}.cpp`);
+
+    if (!await exists(manifest) || !await exists(source)) return;
+
+    const { dependencies } = JSON.parse(decode(await Deno.readFile(manifest)));
+
+    for (const [fileName, fileHash] of Object.entries(dependencies)) {
+      if (await hashFile(fileName) != fileHash) return;
+    }
+
+    return decode(await Deno.readFile(source));
+  }
+
+  async store(key: string, code: string, dependencies: string[]) {
+    const hashes: { [x: string]: string | undefined } = {};
+
+    for (const fileName of dependencies)
+      hashes[fileName] = await hashFile(fileName);
+
+    await Deno.mkdir(this.dir, { recursive: true });
+
+    // The manifest goes last, a lookup never sees an entry half written
+    await this.write(`${key}.cpp`, encode(code));
+    await this.write(`${key}.json`, encode(JSON.stringify({ dependencies: hashes })));
+  }
+
+  // Where the binary built from a key with a given compiler command lives
+  async binaryPath(key: string, command: string[]): Promise<string> {
+    return Path.join(this.dir, `${key}-${(await hash(command.join("\0"))).slice(0, 16)}`);
+  }
+
+  // Written under a temporary name and renamed, so concurrent builds of the
+  // same program can't read each other's partial files
+  async write(fileName: string, data: Uint8Array) {
+    const path = Path.join(this.dir, fileName);
+    const temporary = `${path}.${crypto.randomUUID()}.tmp`;
+
+    await Deno.writeFile(temporary, data);
+    await Deno.rename(temporary, path);
+  }
+}
@@ -0,0 +1,149 @@
+import * as Path from "https://deno.land/std/path/mod.ts";
+import { Runtime } from "../types.ts";
+import { ADKBuildError } from "../errors.ts";
+import { Args } from "./args.ts";
+import BuildCache, { hash } from "./cache.ts";
+import { exists } from "./fs.ts";
+import { BuildFailure, compile, discard, publish } from "./runtime.ts";
+
+const decode = TextDecoder.prototype.decode.bind(new TextDecoder);
+
+// Compiler flags per --profile, so every build of a program is compiled the
+// same way. --cxxflags adds to them. pgo compiles twice around a training run.
+export const PROFILES: { [name: string]: string[] } = {
+  debug: ["-std=c++17", "-O0", "-g"],
+  release: ["-std=c++17", "-O2"],
+  native: ["-std=c++17", "-O3", "-march=native"],
+  lto: ["-std=c++17", "-O3", "-march=native", "-flto=auto"],
+  pgo: ["-std=c++17", "-O3", "-march=native", "-flto=auto"]
+};
+
+export function compiler(): string {
+  return Deno.env.get("CXX") ?? "g++";
+}
+
+export function profile(args: Args): string {
+  const name = args.getArg("--profile") || "release";
+
+  if (!PROFILES.hasOwnProperty(name))
+    new ADKBuildError(`Unknown profile '${name}', expected one of: ${Object.keys(PROFILES).join(", ")}`);
+
+  return name;
+}
+
+export function compilerFlags(args: Args): string[] {
+  const extra = args.getArg("--cxxflags").split(" ").filter((flag) => flag != "");
+  return [...PROFILES[profile(args)], ...extra];
+}
+
+// Runs a program with its output shown, resolving to its exit code
+export async function execute(program: string, args: string[]): Promise<number> {
+  const { code } = await new Deno.Command(program, { args, stdin: "inherit", stdout: "inherit", stderr: "inherit" }).output();
+  return code;
+}
+
+// The training run of a pgo build: --train-args are passed to the program
+// and the file named by --train is its stdin
+async function train(args: Args, program: string, env: { [x: string]: string } = {}) {
+  const input = args.hasArg("--train") ? await Deno.readFile(args.getArg("--train")) : new Uint8Array();
+  const programArgs = args.getArg("--train-args").split(" ").filter((arg) => arg != "");
+
+  const child = new Deno.Command(program, { args: programArgs, env, stdin: "piped", stdout: "null", stderr: "inherit" }).spawn();
+  const writer = child.stdin.getWriter();
+
+  // A program that stops reading early is fine
+  await writer.write(input).catch(() => {});
+  await writer.close().catch(() => {});
+
+  if (!(await child.status).success)
+    throw new BuildFailure("The training run failed");
+}
+
+// What a pgo build's profile depends on besides the program
+async function trainingKey(args: Args): Promise<string> {
+  const input = args.hasArg("--train") ? decode(await Deno.readFile(args.getArg("--train"))) : "";
+  return hash(`${args.getArg("--train-args")}\0${input}`);
+}
+
+// The first step of a pgo build: a build of the program with type probes
+// (Transpiler.probeTypes) does a training run, and the types its Dynamic
+// call arguments held are read back for the transpiler, by site
+export async function profileTypes(args: Args, source: string, runtime: Runtime, cache: BuildCache): Promise<Map<string, number>> {
+  const cxx = compiler();
+  const flags = compilerFlags(args);
+
+  const code = decode(await Deno.readFile(source));
+  const key = await hash(`${code}\0${await trainingKey(args)}`);
+  const profile = `${await cache.binaryPath(key, [cxx, ...flags, "types"])}.types`;
+
+  if (!await exists(profile)) {
+    const work = `${profile}.${crypto.randomUUID()}.tmp`;
+    const program = Path.join(work, "program");
+
+    await Deno.mkdir(work, { recursive: true });
+
+    try {
+      await compile(cxx, [...flags, source, runtime.library, "-o", program]);
+      await train(args, program, { ADK_TYPE_PROFILE: Path.join(work, "types") });
+
+      await publish(Path.join(work, "types"), profile);
+    } finally {
+      await discard(work);
+    }
+  }
+
+  const types: Map<string, number> = new Map;
+
+  // Site names have spaces in them, the mask is what follows the last one
+  for (const line of decode(await Deno.readFile(profile)).split("\n")) {
+    if (line.includes(" "))
+      types.set(line.slice(0, line.lastIndexOf(" ")), parseInt(line.slice(line.lastIndexOf(" ") + 1)));
+  }
+
+  return types;
+}
+
+// Compiles generated C++ against the prebuilt runtime and returns the
+// binary. Binaries are cached on the code, the compiler command and, for
+// pgo, the training input, so an unchanged program is never recompiled.
+export async function buildProgram(args: Args, source: string, runtime: Runtime, cache: BuildCache): Promise<string> {
+  const cxx = compiler();
+  const flags = compilerFlags(args);
+  const pgo = profile(args) == "pgo";
+
+  const code = decode(await Deno.readFile(source));
+  const key = await hash(`${code}\0${pgo ? await trainingKey(args) : ""}`);
+  const binary = await cache.binaryPath(key, [cxx, ...flags, profile(args)]);
+
+  if (await exists(binary)) return binary;
+
+  // The object keeps one path through both pgo compiles, profile data is
+  // looked up by it
+  const work = `${binary}.${crypto.randomUUID()}.tmp`;
+  const object = Path.join(work, "program.o");
+  const linked = Path.join(work, "program");
+
+  await Deno.mkdir(work, { recursive: true });
+
+  // Removed however the build ends, a failed one would otherwise stay in the cache for good
+  try {
+    if (pgo) {
+      const instrumented = [...flags, `-fprofile-generate=${work}`];
+
+      await compile(cxx, [...instrumented, "-c", source, "-o", object]);
+      await compile(cxx, [...instrumented, object, runtime.library, "-o", linked]);
+      await train(args, linked);
+
+      await compile(cxx, [...flags, `-fprofile-use=${work}`, "-fprofile-correction", "-Wno-missing-profile", "-c", source, "-o", object]);
+    } else {
+      await compile(cxx, [...flags, "-c", source, "-o", object]);
+    }
+
+    await compile(cxx, [...flags, object, runtime.library, "-o", linked]);
+    await publish(linked, binary);
+  } finally {
+    await discard(work);
+  }
+
+  return binary;
+}
@@ -0,0 +1,91 @@
+import * as Path from "https://deno.land/std/path/mod.ts";
+import { Runtime } from "../types.ts";
+import { hash } from "./cache.ts";
+import { exists, resolve } from "./fs.ts";
+
+const decode = TextDecoder.prototype.decode.bind(new TextDecoder);
+
+// The runtime as the generated code includes it, runtime.hpp pulls in the rest
+const RUNTIME_FILES = ["runtime.hpp", "langCPP.cpp", "stdio.hpp", "stdio.cpp"];
+
+// Thrown by a failed build step, so temporary files are cleaned up on the
+// way out before main reports it as an ADKBuildError
+export class BuildFailure extends Error {}
+
+// Runs a compiler (or ar), its errors end the build
+export async function compile(compiler: string, args: string[], cwd?: string) {
+  const { success, stderr } = await new Deno.Command(compiler, { args, cwd, stderr: "piped" }).output();
+
+  if (!success)
+    throw new BuildFailure(`${compiler} ${args.join(" ")}\n${decode(stderr)}`);
+}
+
+// Removes a temporary file or directory that may already be gone
+export async function discard(path: string) {
+  await Deno.remove(path, { recursive: true }).catch(() => {});
+}
+
+// Moves a finished file into place unless a concurrent build got there first
+export async function publish(temporary: string, path: string) {
+  if (await exists(path))
+    await Deno.remove(temporary, { recursive: true });
+  else
+    await Deno.rename(temporary, path);
+}
+
+// Builds the runtime once per content and compiler command instead of once
+// per program: a static library with the out-of-line parts and a precompiled
+// runtime.hpp. Each lives in a directory named after the runtime's hash,
+// next to a copy of the sources it was built from, so a stale one is never
+// picked up. GCC keeps one precompiled header per command in runtime.hpp.gch
+// and falls back to the plain header when a program is compiled differently.
+export async function prebuildRuntime(cacheDir: string, compiler: string, flags: string[]): Promise<Runtime> {
+  const sources = RUNTIME_FILES.map((file) => resolve(`./src/builtIns/${file}`));
+  const contents = await Promise.all(sources.map((file) => Deno.readFile(file)));
+  const version = await hash(contents.map((data) => decode(data)).join("\0"));
+
+  const dir = Path.join(cacheDir, `runtime-${version.slice(0, 16)}`);
+  const unique = crypto.randomUUID();
+
+  if (!await exists(dir)) {
+    const temporary = `${dir}.${unique}.tmp`;
+    await Deno.mkdir(temporary, { recursive: true });
+
+    for (const [index, file] of RUNTIME_FILES.entries())
+      await Deno.writeFile(Path.join(temporary, file), contents[index]);
+
+    await publish(temporary, dir);
+  }
+
+  const command = (await hash([compiler, ...flags].join("\0"))).slice(0, 16);
+  const library = Path.join(dir, `libadkruntime-${command}.a`);
+  const precompiled = Path.join(dir, "runtime.hpp.gch", `${command}.gch`);
+
+  if (!await exists(library)) {
+    const object = `stdio-${unique}.o`;
+
+    try {
+      await compile(compiler, [...flags, "-c", "stdio.cpp", "-o", object], dir);
+      await compile("ar", ["rcs", `${library}.${unique}.tmp`, object], dir);
+      await publish(`${library}.${unique}.tmp`, library);
+    } finally {
+      await discard(Path.join(dir, object));
+      await discard(`${library}.${unique}.tmp`);
+    }
+  }
+
+  if (!await exists(precompiled)) {
+    await Deno.mkdir(Path.dirname(precompiled), { recursive: true });
+    // Written outside runtime.hpp.gch, where GCC could find it half done
+    const temporary = Path.join(dir, `${command}.${unique}.tmp`);
+
+    try {
+      await compile(compiler, [...flags, "-x", "c++-header", "runtime.hpp", "-o", temporary], dir);
+      await publish(temporary, precompiled);
+    } finally {
+      await discard(temporary);
+    }
+  }
+
+  return { header: Path.join(dir, "runtime.hpp"), library };
+}
@@ -3,9 +3,35 @@
 
 // FileSystem Module //
 
+// Async Writes //
+
+// Off by default. When on, newFile() and file writes return as soon as
+// their data is queued for the background writer.
+void asyncIO(bool enabled) {
+  AsyncWriter& async = AsyncWriter::instance();
+
+  if (!enabled && !async.wait())
+    throw "Cannot write to file";
+
+  async.enabled = enabled;
+}
+
+// Blocks until every queued write is done
+void waitAll() {
+  if (!AsyncWriter::instance().wait())
+    throw "Cannot write to file";
+}
+
 // New File //
 
 void newFile(std::string filename, std::string text) {
+  AsyncWriter& async = AsyncWriter::instance();
+
+  if (async.enabled) {
+    async.submit({ -1, std::move(filename), std::move(text) });
+    return;
+  }
+
   std::ofstream File(filename);
 
   File << text;
@@ -24,6 +50,8 @@ void newFile(Dynamic filename, Dynamic text) {
     newFile(filename.getString(), std::to_string(text.getInt()));
   else if (text.type == text.DOUBLE)
     newFile(filename.getString(), std::to_string(text.getDouble()));
+  else if (text.type == text.BIGINT)
+    newFile(filename.getString(), text.concatText());
   else if (text.type == text.BOOL) {
     std::string blntext = text.getBoolean() ? "True" : "False";
     newFile(filename.getString(), blntext);
@@ -37,6 +65,8 @@ void newFile(std::string filename, Dynamic text) {
     newFile(filename, std::to_string(text.getInt()));
   else if (text.type == text.DOUBLE)
     newFile(filename, std::to_string(text.getDouble()));
+  else if (text.type == text.BIGINT)
+    newFile(filename, text.concatText());
   else if (text.type == text.BOOL) {
     std::string blntext = text.getBoolean() ? "True" : "False";
     newFile(filename, blntext);
@@ -0,0 +1,219 @@
+// #include "../builtIns/langCPP.cpp"
+#include <cmath>
+
+// Numeric Module //
+// Works on plain 64-bit values and only falls back to BIGINT when a
+// result doesn't fit, so nothing is boxed per step.
+
+// Whole numbers only, a DOUBLE like 4.0 is accepted as 4
+long long integerArg(const Dynamic& value) {
+  if (value.type == value.INT)
+    return value.num;
+  else if (value.type == value.DOUBLE && value.flt == (long long)value.flt)
+    return (long long)value.flt;
+
+  throw "Expected an int";
+}
+
+// GCD / LCM //
+
+unsigned long long magnitude(long long x) {
+  return x < 0 ? 0ULL - (unsigned long long)x : (unsigned long long)x;
+}
+
+long long gcd(long long a, long long b) {
+  unsigned long long x = magnitude(a);
+  unsigned long long y = magnitude(b);
+
+  while (y != 0) {
+    unsigned long long rest = x % y;
+    x = y;
+    y = rest;
+  }
+
+  // Only gcd(LLONG_MIN, 0) and friends land here
+  if (x > (unsigned long long)LLONG_MAX)
+    throw std::overflow_error("Integer overflow in gcd");
+
+  return (long long)x;
+}
+
+long long gcd(const Dynamic& a, const Dynamic& b) {
+  return gcd(integerArg(a), integerArg(b));
+}
+
+long long lcm(long long a, long long b) {
+  if (a == 0 || b == 0)
+    return 0;
+
+  long long result;
+  if (__builtin_mul_overflow(a / gcd(a, b), b, &result))
+    throw std::overflow_error("Integer overflow in lcm");
+
+  return result < 0 ? -result : result;
+}
+
+long long lcm(const Dynamic& a, const Dynamic& b) {
+  return lcm(integerArg(a), integerArg(b));
+}
+
+// Binomial //
+
+// n choose k, built up as exact partial products C(n - k + i, i)
+Dynamic binomial(long long n, long long k) {
+  if (k < 0 || n < 0 || k > n)
+    return Dynamic(0);
+
+  k = std::min(k, n - k);
+
+  unsigned __int128 result = 1;
+  long long i = 1;
+
+  for (; i <= k; i++) {
+    unsigned __int128 next = result * (unsigned __int128)(n - k + i) / i;
+
+    if (next > LLONG_MAX)
+      break;
+
+    result = next;
+  }
+
+  if (i > k)
+    return Dynamic((long long)result);
+
+  Dynamic::BigInt big((long long)result);
+
+  for (; i <= k; i++)
+    big = big * Dynamic::BigInt(n - k + i) / Dynamic::BigInt(i);
+
+  return Dynamic(std::move(big));
+}
+
+Dynamic binomial(const Dynamic& n, const Dynamic& k) {
+  return binomial(integerArg(n), integerArg(k));
+}
+
+// Power //
+
+// Square and multiply, a negative exponent gives a DOUBLE
+Dynamic powInteger(long long base, long long exponent) {
+  if (exponent < 0)
+    return Dynamic(std::pow((double)base, (double)exponent));
+
+  long long result = 1;
+  long long square = base;
+  long long remaining = exponent;
+  bool overflow = false;
+
+  while (remaining > 0 && !overflow) {
+    if (remaining & 1)
+      overflow = __builtin_mul_overflow(result, square, &result);
+
+    remaining >>= 1;
+
+    if (remaining > 0 && !overflow)
+      overflow = __builtin_mul_overflow(square, square, &square);
+  }
+
+  if (!overflow)
+    return Dynamic(result);
+
+  Dynamic::BigInt big(1);
+  Dynamic::BigInt bigSquare(base);
+
+  for (remaining = exponent; remaining > 0; remaining >>= 1) {
+    if (remaining & 1)
+      big = big * bigSquare;
+
+    if (remaining > 1)
+      bigSquare = bigSquare * bigSquare;
+  }
+
+  return Dynamic(std::move(big));
+}
+
+// Templated so integer arguments match exactly instead of tying with ::pow(double, double)
+template<typename T, typename U>
+IfInteger<T, IfInteger<U, Dynamic>> pow(T base, U exponent) {
+  return powInteger(base, exponent);
+}
+
+Dynamic pow(const Dynamic& base, const Dynamic& exponent) {
+  if (base.type == base.INT && exponent.type == exponent.INT)
+    return powInteger(base.num, exponent.num);
+  else if (!base.isNumber() || !exponent.isNumber())
+    throw "Cannot raise a non number type";
+
+  return Dynamic(std::pow(base.toDouble(), exponent.toDouble()));
+}
+
+// Arrays //
+// Packed int/double arrays, see NumericArray. array() copies a list into
+// one, arithmetic and comparisons on them run the vectorised kernels.
+
+NumericArray array(const NumericArray& values) {
+  return values;
+}
+
+NumericArray array(const Dynamic& values) {
+  return values.toArray();
+}
+
+NumericArray zeros(long long size) {
+  if (size < 0)
+    throw "Array size can't be negative";
+
+  return NumericArray(size);
+}
+
+NumericArray zeros(const Dynamic& size) {
+  return zeros(integerArg(size));
+}
+
+// start, start + 1, ... up to but not including end
+NumericArray arange(long long start, long long end) {
+  NumericArray result(end > start ? end - start : 0);
+
+  for (size_t i = 0; i < result.size(); i++)
+    result.data->ints[i] = start + i;
+
+  return result;
+}
+
+NumericArray arange(const Dynamic& start, const Dynamic& end) {
+  return arange(integerArg(start), integerArg(end));
+}
+
+Dynamic sum(const NumericArray& values) {
+  return values.sum();
+}
+
+Dynamic sum(const Dynamic& values) {
+  return values.toArray().sum();
+}
+
+Dynamic min(const NumericArray& values) {
+  return values.min();
+}
+
+Dynamic min(const Dynamic& values) {
+  return values.toArray().min();
+}
+
+Dynamic max(const NumericArray& values) {
+  return values.max();
+}
+
+Dynamic max(const Dynamic& values) {
+  return values.toArray().max();
+}
+
+Dynamic dot(const NumericArray& a, const NumericArray& b) {
+  return a.dot(b);
+}
+
+Dynamic dot(const Dynamic& a, const Dynamic& b) {
+  return a.toArray().dot(b.toArray());
+}
+
+// END Numeric Module //
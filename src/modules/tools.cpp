@@ -1,49 +1,341 @@
 // #include "../builtIns/langCPP.cpp"
+#include <array>
 #include <random>
 
+// Random Engine //
+// xoshiro256**, one per thread and seeded from std::random_device once,
+// instead of a fresh random_device and mt19937 for every number.
+
+class RandomEngine {
+  public:
+
+  uint64_t state[4];
+
+  explicit RandomEngine(uint64_t value) {
+    seed(value);
+  }
+
+  // Expanded with splitmix64, so any seed gives a well mixed state
+  void seed(uint64_t value) {
+    for (uint64_t& word : state) {
+      value += 0x9e3779b97f4a7c15;
+
+      uint64_t mixed = value;
+      mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9;
+      mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111eb;
+
+      word = mixed ^ (mixed >> 31);
+    }
+  }
+
+  static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t next() {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t shifted = state[1] << 17;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+
+    state[2] ^= shifted;
+    state[3] = rotl(state[3], 45);
+
+    return result;
+  }
+
+  // [0, 1) from the top 53 bits
+  double nextDouble() {
+    return (next() >> 11) * 0x1.0p-53;
+  }
+
+  // [0, range) without modulo bias, range 0 means all 64 bits
+  uint64_t nextBelow(uint64_t range) {
+    if (range == 0)
+      return next();
+
+    unsigned __int128 product = (unsigned __int128)next() * range;
+    uint64_t low = (uint64_t)product;
+
+    if (low < range) {
+      uint64_t threshold = (0 - range) % range;
+
+      while (low < threshold) {
+        product = (unsigned __int128)next() * range;
+        low = (uint64_t)product;
+      }
+    }
+
+    return product >> 64;
+  }
+
+  // Uniform over [start, end], in either order like randint always was
+  long long nextBetween(long long start, long long end) {
+    if (start > end)
+      std::swap(start, end);
+
+    uint64_t range = (uint64_t)end - (uint64_t)start + 1;
+    return (long long)((uint64_t)start + nextBelow(range));
+  }
+};
+
+RandomEngine& randomEngine() {
+  thread_local RandomEngine engine(((uint64_t)std::random_device{}() << 32) | std::random_device{}());
+  return engine;
+}
+
+// Same seed, same sequence, for reproducible runs
+void seed(long long value) {
+  randomEngine().seed(value);
+}
+
+void seed(const Dynamic& value) {
+  seed(value.getInt());
+}
+
 Dynamic randnum() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<double> dis(0.0, 1.0);
-  return Dynamic(dis(gen));
+  return Dynamic(randomEngine().nextDouble());
+}
+
+Dynamic randint(long long start, long long end) {
+  return Dynamic(randomEngine().nextBetween(start, end));
+}
+
+Dynamic randint(const Dynamic& start, const Dynamic& end) {
+  return randint(start.getInt(), end.getInt());
+}
+
+// Bulk versions, filled in one pass straight into a NumericArray
+NumericArray randints(long long count, long long start, long long end) {
+  RandomEngine& engine = randomEngine();
+  NumericArray numbers(count > 0 ? count : 0);
+
+  for (long long& number : numbers.data->ints)
+    number = engine.nextBetween(start, end);
+
+  return numbers;
+}
+
+NumericArray randints(const Dynamic& count, const Dynamic& start, const Dynamic& end) {
+  return randints(count.getInt(), start.getInt(), end.getInt());
 }
 
-Dynamic randint(int start, int end) {
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<double> dis(0.0, 1.0);//uniform distribution between 0 and 1
+NumericArray randnums(long long count) {
+  RandomEngine& engine = randomEngine();
+  NumericArray numbers(count > 0 ? count : 0, true);
 
-  bool isNegative = (end - start < 0);
-  int end_start = (!isNegative)
-    ? end - start + 1
-    : (end + (start - end)) - (start - (start - end)) + 1;
+  for (double& number : numbers.data->doubles)
+    number = engine.nextDouble();
 
-  return (int)((randnum() * (double)end_start) + (isNegative ? end : start)).getDouble();
+  return numbers;
 }
 
+NumericArray randnums(const Dynamic& count) {
+  return randnums(count.getInt());
+}
+
+// Random Choice //
+
+// Converts only the argument that was picked, nothing is copied or allocated
 template<typename ... Args>
-Dynamic randomchoice(Args... args) {
-  std::vector<Dynamic> x = {
-    args...
-  };
+Dynamic randomchoice(const Args&... args) {
+  static_assert(sizeof...(Args) > 0, "randomchoice needs something to choose from");
+
+  size_t index = randomEngine().nextBelow(sizeof...(Args));
+  size_t position = 0;
+  Dynamic choice;
 
-  int size = x.size();
+  ((position++ == index ? (choice = Dynamic(args), true) : false) || ...);
 
-  return x[randint(0, size-1).getInt()];
+  return choice;
 }
 
-Dynamic factorial(int number) {
-  if (number == 1) {
-    return 1;
-  }
+template<typename T>
+T randomchoice(const std::vector<T>& items) {
+  if (items.empty())
+    throw "Cannot choose from an empty list";
+
+  return items[randomEngine().nextBelow(items.size())];
+}
 
-  return number * factorial(number - 1);
+// An element of a NumericArray, boxed like indexing one
+Dynamic arrayElement(const NumericArray& items, size_t index) {
+  if (items.isDouble())
+    return Dynamic(items.data->doubles[index]);
+
+  return Dynamic(items.data->ints[index]);
 }
 
-Dynamic factorial(Dynamic number) {
-  if (number == 1) {
-    return 1;
+Dynamic randomchoice(const NumericArray& items) {
+  if (items.size() == 0)
+    throw "Cannot choose from an empty array";
+
+  return arrayElement(items, randomEngine().nextBelow(items.size()));
+}
+
+// An element of an ADK list or array, anything else is the only choice there is
+Dynamic randomchoice(const Dynamic& items) {
+  if (items.type == items.ARRAY)
+    return randomchoice(items.toArray());
+  else if (items.type != items.LIST)
+    return items;
+
+  return randomchoice(items.list->items);
+}
+
+// Walker/Vose alias table, built once in O(n) from a list of weights so
+// every weighted pick after that is O(1)
+class AliasTable {
+  public:
+
+  std::vector<double> probability;
+  std::vector<size_t> alias;
+
+  template<typename T>
+  explicit AliasTable(const std::vector<T>& weights) {
+    std::vector<double> scaled(weights.size());
+
+    for (size_t i = 0; i < weights.size(); i++) {
+      if constexpr (std::is_same_v<T, Dynamic>)
+        scaled[i] = weights[i].toDouble();
+      else
+        scaled[i] = (double)weights[i];
+    }
+
+    build(scaled);
+  }
+
+  explicit AliasTable(const NumericArray& weights) {
+    build(weights.asDoubles());
+  }
+
+  // From ADK, `table = AliasTable(weights)` with a list or an array
+  explicit AliasTable(const Dynamic& weights) {
+    if (weights.type == weights.ARRAY)
+      build(weights.toArray().asDoubles());
+    else if (weights.type == weights.LIST)
+      *this = AliasTable(weights.list->items);
+    else
+      throw "Weights must be a list or an array";
+  }
+
+  void build(std::vector<double> scaled) {
+    size_t size = scaled.size();
+    double total = 0;
+
+    for (size_t i = 0; i < size; i++) {
+      if (!(scaled[i] >= 0))
+        throw "Weights can't be negative";
+
+      total += scaled[i];
+    }
+
+    if (!(total > 0))
+      throw "Cannot choose without a positive weight";
+
+    probability.resize(size);
+    alias.resize(size);
+
+    std::vector<size_t> small;
+    std::vector<size_t> large;
+
+    for (size_t i = 0; i < size; i++) {
+      scaled[i] = scaled[i] * size / total;
+      (scaled[i] < 1 ? small : large).push_back(i);
+    }
+
+    while (!small.empty() && !large.empty()) {
+      size_t less = small.back();
+      size_t more = large.back();
+
+      small.pop_back();
+      large.pop_back();
+
+      probability[less] = scaled[less];
+      alias[less] = more;
+
+      scaled[more] = (scaled[more] + scaled[less]) - 1;
+      (scaled[more] < 1 ? small : large).push_back(more);
+    }
+
+    // Whatever is left is 1 up to rounding
+    for (size_t i : large) probability[i] = 1;
+    for (size_t i : small) probability[i] = 1;
+  }
+
+  size_t next() const {
+    RandomEngine& engine = randomEngine();
+    size_t column = engine.nextBelow(probability.size());
+
+    return engine.nextDouble() < probability[column] ? column : alias[column];
   }
+};
+
+template<typename T>
+T randomchoice(const std::vector<T>& items, const AliasTable& table) {
+  if (items.size() != table.probability.size())
+    throw "Weights don't match the list being chosen from";
+
+  return items[table.next()];
+}
+
+Dynamic randomchoice(const NumericArray& items, const AliasTable& table) {
+  if (items.size() != table.probability.size())
+    throw "Weights don't match the array being chosen from";
+
+  return arrayElement(items, table.next());
+}
+
+Dynamic randomchoice(const Dynamic& items, const AliasTable& table) {
+  if (items.type == items.ARRAY)
+    return randomchoice(items.toArray(), table);
+  else if (items.type != items.LIST)
+    throw "Can only choose from a list or an array";
+
+  return randomchoice(items.list->items, table);
+}
+
+// Factorial //
+
+// 20! is the largest that fits in a long long
+constexpr int FACTORIAL_TABLE_SIZE = 21;
 
-  return number * factorial(number - 1);
-}
\ No newline at end of file
+constexpr std::array<long long, FACTORIAL_TABLE_SIZE> factorialTable() {
+  std::array<long long, FACTORIAL_TABLE_SIZE> table {};
+  table[0] = 1;
+
+  for (int i = 1; i < FACTORIAL_TABLE_SIZE; i++)
+    table[i] = table[i - 1] * i;
+
+  return table;
+}
+
+constexpr std::array<long long, FACTORIAL_TABLE_SIZE> FACTORIALS = factorialTable();
+
+// A table lookup up to 20!, a BIGINT built iteratively past that
+Dynamic factorial(long long number) {
+  if (number < 0)
+    throw "Cannot take the factorial of a negative number";
+
+  if (number < FACTORIAL_TABLE_SIZE)
+    return Dynamic(FACTORIALS[number]);
+
+  Dynamic::BigInt result(FACTORIALS[FACTORIAL_TABLE_SIZE - 1]);
+
+  for (long long i = FACTORIAL_TABLE_SIZE; i <= number; i++)
+    result = result * Dynamic::BigInt(i);
+
+  return Dynamic(std::move(result));
+}
+
+Dynamic factorial(const Dynamic& number) {
+  if (number.type == number.DOUBLE && number.flt == (long long)number.flt)
+    return factorial((long long)number.flt);
+  else if (number.type != number.INT)
+    throw "Cannot take the factorial of a non int type";
+
+  return factorial(number.num);
+}
@@ -0,0 +1,279 @@
+import { Scope, Statement } from "./parser.ts";
+
+const arithmetic = ["+", "-", "*", "/", "%"];
+const comparisons = ["==", "!=", "<", ">", "<=", ">="];
+
+// Folds constant expressions, propagates variables that only ever hold one
+// constant and drops branches that can never run. Runs between parsing and
+// type inference, and only folds what evaluates the same way at runtime.
+export default class Optimizer {
+  // Assignments per name in the function being optimised
+  assignments: Map<string, number>;
+  constants: Map<string, any>;
+
+  constructor() {
+    this.assignments = new Map;
+    this.constants = new Map;
+  }
+
+  optimize(ast: Scope): Scope {
+    this.enter(ast, []);
+    return ast;
+  }
+
+  // Each function (and main) gets its own constants, C++ functions can't see main's locals
+  enter(scope: Scope, parameters: any[]) {
+    const outer = [this.assignments, this.constants];
+
+    this.assignments = new Map;
+    this.constants = new Map;
+
+    for (const param of parameters) this.count(param.value, 2);
+    this.countAssignments(scope);
+
+    scope.block = this.block(scope.block, true);
+
+    [this.assignments, this.constants] = outer;
+  }
+
+  count(name: string, times = 1) {
+    this.assignments.set(name, (this.assignments.get(name) ?? 0) + times);
+  }
+
+  countAssignments(exp: any) {
+    if (!exp || typeof exp != "object" || exp.type == "Function") return;
+
+    if (exp.type == "Assign" && exp.left?.type == "Identifier") this.count(exp.left.value);
+    if (exp.type == "ForLoop") this.count(exp.value.variable.value, 2);
+
+    for (const value of Object.values(exp)) {
+      if (Array.isArray(value)) value.forEach((item) => this.countAssignments(item));
+      else this.countAssignments(value);
+    }
+  }
+
+  static isConstant(exp: any): boolean {
+    return exp?.type == "Number" || exp?.type == "String" || exp?.type == "Boolean";
+  }
+
+  static constant(type: string, value: any, from: any): any {
+    if (type == "Boolean") return new Statement("Boolean", value);
+    return { type, value, index: from.index, line: from.line };
+  }
+
+  // Statements of a block, with the unreachable ones left out
+  block(statements: any[], top: boolean): any[] {
+    const result = [];
+
+    for (const statement of statements) {
+      const optimised = this.statement(statement, top);
+
+      if (optimised === undefined) continue;
+      if (Array.isArray(optimised)) result.push(...optimised);
+      else result.push(optimised);
+
+      // Nothing after a return runs
+      if (statement.type == "Return") break;
+    }
+
+    return result;
+  }
+
+  statement(exp: any, top: boolean): any {
+    if (!exp || typeof exp != "object") return exp;
+
+    switch (exp.type) {
+      case "Function":
+        this.enter(exp.value.scope, exp.value.parameters);
+        return exp;
+
+      case "Assign": {
+        exp.right = this.expression(exp.right);
+        if (exp.left?.type == "Index") exp.left = this.expression(exp.left);
+
+        const name = exp.left?.value;
+
+        // Only a single top-level assignment can't be skipped or repeated
+        if (top && exp.op == "=" && exp.left?.type == "Identifier" && this.assignments.get(name) == 1 && Optimizer.isConstant(exp.right))
+          this.constants.set(name, exp.right);
+
+        return exp;
+      }
+
+      case "If": {
+        exp.value.condition = this.expression(exp.value.condition);
+        const { condition } = exp.value;
+
+        // A constant condition keeps only the branch that runs, unbraced like a scope
+        if (condition.type == "Boolean") {
+          const branch = condition.value ? exp.value.then : exp.value.else;
+          if (!branch) return undefined;
+
+          return branch.type == "Scope" ? this.block(branch.block, false) : this.statement(branch, false);
+        }
+
+        exp.value.then.block = this.block(exp.value.then.block, false);
+
+        if (exp.value.else?.type == "Scope")
+          exp.value.else.block = this.block(exp.value.else.block, false);
+        else if (exp.value.else)
+          exp.value.else = this.statement(exp.value.else, false) ?? undefined;
+
+        // `else if False {}` folded away, or down to a plain block
+        if (Array.isArray(exp.value.else))
+          exp.value.else = new Scope(undefined, exp.value.else);
+
+        return exp;
+      }
+
+      case "ForLoop":
+        exp.value.iterable = this.expression(exp.value.iterable);
+        exp.value.scope.block = this.block(exp.value.scope.block, false);
+        return exp;
+
+      // A loop that can never start is dropped, one that never ends stays
+      case "WhileLoop":
+        exp.value.condition = this.expression(exp.value.condition);
+        if (exp.value.condition.type == "Boolean" && !exp.value.condition.value) return undefined;
+
+        exp.value.scope.block = this.block(exp.value.scope.block, false);
+        return exp;
+
+      case "Return":
+        exp.value = this.expression(exp.value);
+        return exp;
+
+      case "Scope":
+        exp.block = this.block(exp.block, false);
+        return exp;
+    }
+
+    return this.expression(exp);
+  }
+
+  expression(exp: any): any {
+    if (!exp || typeof exp != "object") return exp;
+
+    switch (exp.type) {
+      case "Identifier":
+        if (exp.dotOp) {
+          exp.dotOp = this.member(exp.dotOp);
+          return exp;
+        }
+
+        return this.constants.has(exp.value)
+          ? Optimizer.constant(this.constants.get(exp.value).type, this.constants.get(exp.value).value, exp)
+          : exp;
+
+      case "Binary": {
+        exp.left = this.expression(exp.left);
+        exp.right = this.expression(exp.right);
+
+        return this.fold(exp) ?? exp;
+      }
+
+      case "Assign":
+        return this.statement(exp, false);
+
+      case "FunctionCall":
+        exp.value.args = exp.value.args.map((arg: any) => this.expression(arg));
+        if (exp.value.dotOp) exp.value.dotOp = this.member(exp.value.dotOp);
+        return exp;
+
+      case "List":
+        exp.value = exp.value.map((item: any) => this.expression(item));
+        return exp;
+
+      case "Map":
+        exp.value = exp.value.map(({ key, value }: any) => ({ key: this.expression(key), value: this.expression(value) }));
+        return exp;
+
+      case "Index":
+        exp.value.target = this.expression(exp.value.target);
+        exp.value.index = this.expression(exp.value.index);
+        if (exp.value.dotOp) exp.value.dotOp = this.member(exp.value.dotOp);
+        return exp;
+    }
+
+    return exp;
+  }
+
+  // After a dot only call arguments are expressions, the names are members
+  member(exp: any): any {
+    if (exp?.type == "FunctionCall") {
+      exp.value.args = exp.value.args.map((arg: any) => this.expression(arg));
+      if (exp.value.dotOp) exp.value.dotOp = this.member(exp.value.dotOp);
+    } else if (exp?.type == "Identifier" && exp.dotOp) {
+      exp.dotOp = this.member(exp.dotOp);
+    }
+
+    return exp;
+  }
+
+  // The constant `left op right` evaluates to, undefined when it isn't
+  // known exactly (overflow, division by zero, a double that would print
+  // or promote differently)
+  fold(exp: any): any {
+    const { left, right, op } = exp;
+    if (!Optimizer.isConstant(left) || !Optimizer.isConstant(right)) return;
+
+    const a = left.value;
+    const b = right.value;
+
+    if (left.type == "Number" && right.type == "Number") {
+      // An int and a double meet as whatever the left one is at runtime
+      // (1 + 2.5 is 3), so only operands of one kind are folded
+      if (Number.isSafeInteger(a) != Number.isSafeInteger(b)) return;
+
+      if (comparisons.includes(op))
+        return Optimizer.constant("Boolean", Optimizer.compare(op, a, b), left);
+
+      if (!arithmetic.includes(op)) return;
+
+      const integers = Number.isSafeInteger(a) && Number.isSafeInteger(b);
+      let value: number;
+
+      if (op == "+") value = a + b;
+      else if (op == "-") value = a - b;
+      else if (op == "*") value = a * b;
+      else if (b == 0) return;
+      else if (op == "/") value = integers ? Math.trunc(a / b) : a / b;
+      else if (integers) value = a % b;
+      else return;
+
+      // Ints that would overflow become BIGINT at runtime, and a double
+      // that lands on a whole number would turn into an int literal
+      if (integers ? !Number.isSafeInteger(value) : (Number.isInteger(value) || !Number.isFinite(value)))
+        return;
+
+      return Optimizer.constant("Number", value, left);
+    }
+
+    if (left.type == "String" || right.type == "String") {
+      // A number beside a string is left to the transpiler and runtime, which
+      // don't always join the two (a Dynamic int + string stays the int)
+      if (left.type != "String" || right.type != "String") return;
+
+      if (op == "+")
+        return Optimizer.constant("String", a + b, left);
+
+      if (op == "==" || op == "!=")
+        return Optimizer.constant("Boolean", Optimizer.compare(op, a, b), left);
+
+      return;
+    }
+
+    if (left.type == "Boolean" && right.type == "Boolean" && (op == "==" || op == "!="))
+      return Optimizer.constant("Boolean", Optimizer.compare(op, a, b), left);
+  }
+
+  static compare(op: string, a: any, b: any): boolean {
+    if (op == "==") return a == b;
+    if (op == "!=") return a != b;
+    if (op == "<") return a < b;
+    if (op == ">") return a > b;
+    if (op == "<=") return a <= b;
+
+    return a >= b;
+  }
+}
@@ -11,7 +11,7 @@ import { readFile, resolve } from "./mods/fs.ts";
 const { os } = Deno.build;
 
 const PREC: Precedence = {
-	"=": 1,
+	"=": 1, "+=": 1, "-=": 1, "*=": 1, "%=": 1,
 
 	"&": 2,
 	"^": 3, "xor": 3,
@@ -90,6 +90,7 @@ export default class Parser { // Modify the parser as you please
 		filepath: string,
 		filename: string
 	}>;
+	included!: string[]; // ADK files pulled in by #include
 
 	constructor(lexer?: Lexer) {
 		Object.assign(
@@ -105,7 +106,8 @@ export default class Parser { // Modify the parser as you please
 				pos: 0,
 
 				ast: new Scope("main"),
-				libs: {}
+				libs: {},
+				included: []
 			}
 		);
 	}
@@ -449,6 +451,7 @@ export default class Parser { // Modify the parser as you please
 		}
 
 		const data = decoder.decode(Deno.readFileSync(filepath));
+		this.included.push(filepath);
 
 		const lexer = new Lexer(data, filepath, this.grammar);
 		const newtokens = lexer.tokenize();
@@ -532,6 +535,83 @@ export default class Parser { // Modify the parser as you please
 		return ifStatement;
 	}
 
+	pFor(): Statement {
+		this.skipOver("for");
+
+		const forLoop = new Statement("ForLoop");
+		const variable = this.curTok;
+		if (!this.isIdentifier()) new ADKSyntaxError(`Invalid token '${this.curTok.value}' at line ${this.curTok.line + 1}\n${this.lines[this.curTok.line]}`);
+		this.advance();
+
+		this.skipOver("in");
+
+		forLoop.value = {
+			variable,
+			iterable: this.pExpression(),
+			scope: new Scope(undefined, this.pDelimiters("{", "}", this.grammar.Ignore, this.pExpression))
+		};
+
+		return forLoop;
+	}
+
+	pWhile(): Statement {
+		this.skipOver("while");
+
+		const whileLoop = new Statement("WhileLoop");
+
+		whileLoop.value = {
+			condition: this.pExpression(),
+			scope: new Scope(undefined, this.pDelimiters("{", "}", this.grammar.Ignore, this.pExpression))
+		};
+
+		return whileLoop;
+	}
+
+	// i++ and xs[i]-- are the same assignments as i += 1 and xs[i] -= 1
+	pStep(target: any): any {
+		if (!this.isOperator("++") && !this.isOperator("--")) return target;
+
+		const op = this.curTok;
+		this.advance();
+
+		return new Expression("Assign", target, op.value == "++" ? "+=" : "-=", {
+			type: "Number",
+			value: 1,
+			index: op.index,
+			line: op.line
+		});
+	}
+
+	// [1, "two", True]
+	pList(): Statement {
+		return new Statement("List", this.pDelimiters("[", "]", ",", this.pExpression));
+	}
+
+	// {"key": value, 2: value}
+	pMap(): Statement {
+		return new Statement("Map", this.pDelimiters("{", "}", ",", this.pMapEntry));
+	}
+
+	pMapEntry(): { key: any, value: any } {
+		const key = this.pExpression();
+		this.skipOver(":", undefined, true);
+
+		return { key, value: this.pExpression() };
+	}
+
+	// target[index][index]...
+	pIndex(target: any): any {
+		while (this.isDelimiter("[")) {
+			this.skipOver("[");
+			const index = this.pExpression();
+			this.skipOver("]", undefined, true);
+
+			target = new Statement("Index", { target, index });
+		}
+
+		return target;
+	}
+
 	pReturn(): Statement {
 		this.skipOver("return");
 
@@ -569,6 +649,12 @@ export default class Parser { // Modify the parser as you please
 			if (this.isKeyword("if"))
 				return this.pIf();
 
+			if (this.isKeyword("for"))
+				return this.pFor();
+
+			if (this.isKeyword("while"))
+				return this.pWhile();
+
 			if (this.isKeyword("funct"))
 				return this.pFunction();
 
@@ -578,6 +664,12 @@ export default class Parser { // Modify the parser as you please
 			if (this.isKeyword("True") || this.isKeyword("False"))
 				return this.pBoolean();
 
+			if (this.isDelimiter("["))
+				return this.pList();
+
+			if (this.isDelimiter("{"))
+				return this.pMap();
+
 			const oldTok = this.curTok;
 
 			if (this.isNumber() || this.isString()) {
@@ -590,16 +682,16 @@ export default class Parser { // Modify the parser as you please
 				if (!this.isDelimiter("(", this.peek()))
 					this.advance();
 
-				const Identifier: { [x: string]: any } = {
+				const Identifier: { [x: string]: any } = this.pIndex({
 					...oldTok,
-				}
+				});
 
 				if (this.isDelimiter(".")) {
 					this.advance();
-					Identifier.dotOp = this.pExpression();
+					(Identifier.type == "Index" ? Identifier.value : Identifier).dotOp = this.pExpression();
 				}
 
-				return Identifier;
+				return this.pStep(Identifier);
 			}
 
 			if (this.isIgnore()) {
@@ -633,7 +725,8 @@ export default class Parser { // Modify the parser as you please
 					pos: 0,
 
 					ast: new Scope("main"),
-					libs: {}
+					libs: {},
+					included: []
 				}
 			);
 		}
@@ -1,8 +1,9 @@
 import Parser, { Expression, Scope, Statement } from "./parser.ts";
-import { LexerGrammar, Token } from "./types.ts";
+import { LexerGrammar, Runtime, Token } from "./types.ts";
 import * as Path from "https://deno.land/std@0.65.0/path/mod.ts";
 import { ADKError, ADKSyntaxError } from "./errors.ts";
 import { resolve } from "./mods/fs.ts";
+import TypeInference, { Types } from "./inference.ts";
 
 export class Prettier {
   spaces: number;
@@ -44,6 +45,10 @@ export default class Transpiler {
   mainIndex: number;
   code: string;
 
+  // Type profiles, see createFuncCall
+  probeTypes: boolean;
+  typeProfile: Map<string, number>;
+
   constructor(parser: Parser) {
     this.ast = parser.ast;
     this.grammar = parser.grammar;
@@ -53,6 +58,9 @@ export default class Transpiler {
 
     this.code = "";
     this.mainIndex = 0;
+
+    this.probeTypes = false;
+    this.typeProfile = new Map;
   }
 
   async defineLib(filepath: string) {
@@ -62,18 +70,35 @@ export default class Transpiler {
     this.code += data + "\n\n\n";
   }
 
+  // Pastes the runtime in, its own #include "..." lines are left out
+  // since what they name is pasted too
   async defineLibs(filepaths: string[]) {
     for (const filepath of filepaths) {
       const fullpath = resolve(filepath);
       const data = new TextDecoder("utf8").decode(await Deno.readFile(fullpath));
 
-      this.code += data + "\n\n";
+      this.code += data.replace(/^#include ".*"\n/gm, "") + "\n\n";
     }
   }
 
+  // Includes a prebuilt runtime instead of pasting it, so its precompiled
+  // header is used. The program then has to be linked with its library.
+  includeRuntime(runtime: Runtime) {
+    this.code += `// Link with ${runtime.library}\n#include "${runtime.header}"\n\n\n`;
+  }
+
   transpile(expr: any = this.ast, spacing: Prettier = new Prettier(2, 1)) {
     const functions: { [x: string]: any } = {};
+    const prototypes: string[] = [];
     const variables: Map<string, boolean> = new Map;
+    const literals: Map<string, string> = new Map;
+    const interned: Map<string, string> = new Map;
+    const sites: string[] = [];
+    let ranges = 0;
+
+    const { probeTypes, typeProfile } = this;
+    const types = new TypeInference(typeProfile).infer(expr);
+    let scope = "main";
 
     function createScope(exp: Scope, spacing?: Prettier) {
       let code = "";
@@ -82,6 +107,7 @@ export default class Transpiler {
 
       if (exp.name == "main") {
         code = "int main(int argc, char** argv) {\n" + (spacing?.getString() ?? "");
+        code += "setupIO();\n" + (spacing?.getString() ?? "");
         code += exp.block.map((value: string, index: number, array: any[]) => CPP(array[index], spacing)).join(";\n" + (spacing?.getString() ?? ""));
         code += ";\n};";
       } else {
@@ -95,18 +121,87 @@ export default class Transpiler {
       return str.replace(/\\(n|r|U|033|u|t|l|x)/g, "$1");
     }
 
+    // String literals are built once, as file-scope constants, instead of a
+    // new std::string every time the expression runs
     function createType(exp: any, spacing?: Prettier) {
-      if (exp.type == "String")
-        return "std::string(" + fixEscapes(JSON.stringify(exp.value)) + ")";
+      if (exp.type == "String") {
+        const literal = fixEscapes(JSON.stringify(exp.value));
+
+        if (!literals.has(literal))
+          literals.set(literal, `LITERAL_${literals.size}`);
+
+        return literals.get(literal) as string;
+      }
+
+      // Integer literals are 64-bit, past 2^53 they were already parsed as doubles
+      if (exp.type == "Number" && Number.isInteger(exp.value)) {
+        const literal = JSON.stringify(exp.value);
+
+        if (Number.isSafeInteger(exp.value)) return literal + "LL";
+        return /e/.test(literal) ? literal : literal + ".0";
+      }
+
       return JSON.stringify(exp.value);
     }
 
+    // String literals that end up in a Dynamic (list items, map keys, indices)
+    // become one interned constant each, so they're never rebuilt and compare
+    // and hash in O(1)
+    function createDynamic(exp: any, spacing?: Prettier): string {
+      if (exp?.type != "String") return CPP(exp, spacing);
+
+      const literal = fixEscapes(JSON.stringify(exp.value));
+
+      if (!interned.has(literal))
+        interned.set(literal, `INTERNED_${interned.size}`);
+
+      return interned.get(literal) as string;
+    }
+
+    // Native ints only step by small constants (TypeInference.isSmallStep),
+    // the rest is Dynamic and promotes to a bigint. The checks catch the
+    // extremes, like a counter that starts next to the 64-bit limit.
+    const checked: { [x: string]: string } = { "+": "checkedAdd", "-": "checkedSub" };
+
     function createBinary(exp: any, spacing?: Prettier): string {
-      return "(" + CPP(exp.left, spacing) + " " + exp.op + " " + CPP(exp.right, spacing) + ")";
+      const leftType = types.typeOf(exp.left, scope);
+      const rightType = types.typeOf(exp.right, scope);
+      const type = TypeInference.binaryType(exp.op, leftType, rightType, [exp.left, exp.right]);
+
+      let left = CPP(exp.left, spacing);
+      let right = CPP(exp.right, spacing);
+
+      // A Dynamic checked against a string literal meets its interned
+      // constant, two interned strings are equal by pointer
+      if (exp.op == "==" || exp.op == "!=") {
+        if (leftType == Types.DYNAMIC && exp.right.type == "String") right = createDynamic(exp.right, spacing);
+        if (rightType == Types.DYNAMIC && exp.left.type == "String") left = createDynamic(exp.left, spacing);
+      }
+
+      if (type == Types.ARRAY) {
+        // Both sides are arrays or numbers, NumericArray's operators run the vector kernels
+      } else if (leftType == Types.ARRAY || rightType == Types.ARRAY) {
+        if (TypeInference.isNative(leftType)) left = `Dynamic(${left})`;
+      } else if (type == Types.STRING) {
+        // Native string concatenation, numbers are stringified the way Dynamic does it
+        if (leftType != Types.STRING) left = `std::to_string(${left})`;
+        if (rightType != Types.STRING) right = `std::to_string(${right})`;
+      } else if (TypeInference.isNative(leftType) && TypeInference.isNative(rightType)) {
+        const sameKind = leftType == rightType
+          || (TypeInference.isNumeric(leftType) && TypeInference.isNumeric(rightType));
+
+        // Mixed native operands go through Dynamic to keep its semantics
+        if (type == Types.DYNAMIC || !sameKind) left = `Dynamic(${left})`;
+      }
+
+      if (type == Types.INT && leftType == Types.INT && rightType == Types.INT && checked[exp.op])
+        return `${checked[exp.op]}(${left}, ${right})`;
+
+      return "(" + left + " " + exp.op + " " + right + ")";
     }
 
     function createIf(exp: Statement, spacing?: Prettier): string {
-      let code = "if " + CPP(exp.value.condition, spacing) + " {\n"
+      let code = "if (" + CPP(exp.value.condition, spacing) + ") {\n"
         + CPP(exp.value.then, spacing)
         + "}";
 
@@ -115,36 +210,254 @@ export default class Transpiler {
       return code;
     }
 
+    // Whether a name is assigned to anywhere inside a block
+    function assigns(exp: any, name: string): boolean {
+      if (!exp || typeof exp != "object" || exp.type == "Function") return false;
+      if (exp.type == "Assign" && exp.left.value == name) return true;
+
+      return Object.values(exp).some((value) => Array.isArray(value)
+        ? value.some((item) => assigns(item, name))
+        : assigns(value, name));
+    }
+
+    // Whether a block may change a collection: a method call (xs.push),
+    // an element assignment or a call into an ADK function that could
+    // do either
+    function mutates(exp: any): boolean {
+      if (!exp || typeof exp != "object" || exp.type == "Function") return false;
+      if (exp.dotOp || exp.value?.dotOp) return true;
+      if (exp.type == "Assign" && exp.left.type == "Index") return true;
+      if (exp.type == "FunctionCall" && types.functions.has(exp.value.name.value)) return true;
+
+      return Object.values(exp).some((value) => Array.isArray(value)
+        ? value.some((item) => mutates(item))
+        : mutates(value));
+    }
+
+    // `for x in value` walks a list, a map's keys, a string or a file's lines,
+    // `for chunk in file.chunks(size)` streams a file with constant memory
+    function createFor(exp: Statement, spacing?: Prettier): string {
+      const { variable, iterable } = exp.value;
+      const name = variable.value;
+      const key = `${scope}:${name}`;
+      const type = types.variableType(scope, name);
+      const declared = variables.has(key);
+
+      const range = TypeInference.isStream(iterable)
+        ? CPP(iterable, spacing)
+        : `${asDynamic(iterable, spacing)}.each()`;
+
+      // Read-only loop variables bind to the element (or the reader's reused line) instead of copying it,
+      // unless the body could grow the list and move the element away
+      const declaration = (type == Types.STRING || type == Types.DYNAMIC) && !assigns(exp.value.scope, name) && !mutates(exp.value.scope)
+        ? `const ${type}& ${name}`
+        : `${type} ${name}`;
+
+      variables.set(key, true);
+
+      const code = (createCounted(exp, spacing) ?? `for (${declaration} : ${range}) {\n`)
+        + CPP(exp.value.scope, spacing)
+        + "}";
+
+      if (!declared) variables.delete(key);
+
+      return code;
+    }
+
+    // `for i in range(start, stop, step)` over ints counts with a native
+    // long long instead of building the array. The bounds are evaluated once,
+    // and a body that reassigns i gets a copy so it can't change the count.
+    // Only a constant step says which way to compare, others use the array.
+    function createCounted(exp: Statement, spacing?: Prettier): string | undefined {
+      const { variable, iterable } = exp.value;
+      const name = variable.value;
+
+      if (!TypeInference.isRange(iterable, types.functions) || types.variableType(scope, name) != Types.INT) return;
+
+      const args = iterable.value.args;
+      const step = args[2];
+
+      if (args.some((arg: any) => types.typeOf(arg, scope) != Types.INT)) return;
+      if (step && (step.type != "Number" || step.value == 0)) return;
+
+      const end = `RANGE_${ranges++}`;
+      const counter = assigns(exp.value.scope, name) ? `RANGE_${ranges++}` : name;
+
+      const start = args.length > 1 ? CPP(args[0], spacing) : "0LL";
+      const stop = CPP(args[args.length > 1 ? 1 : 0], spacing);
+      const next = !step || step.value == 1 ? `++${counter}` : `${counter} += ${CPP(step, spacing)}`;
+
+      let code = `for (long long ${counter} = ${start}, ${end} = ${stop}; ${counter} ${step?.value < 0 ? ">" : "<"} ${end}; ${next}) {\n`;
+
+      if (counter != name)
+        code += `${new Prettier(2, (spacing?.getLevel() ?? 0) + 1).getString()}long long ${name} = ${counter};\n`;
+
+      return code;
+    }
+
+    function createWhile(exp: Statement, spacing?: Prettier): string {
+      return "while (" + CPP(exp.value.condition, spacing) + ") {\n"
+        + CPP(exp.value.scope, spacing)
+        + "}";
+    }
+
     function createIdentifier(exp: { [x: string]: any }, spacing?: Prettier): string {
       return (exp.dotOp ? `${exp.value}.${CPP(exp.dotOp, new Prettier(2, 0))}` : exp.value);
     }
 
+    // Code for exp as a Dynamic, for the places only a Dynamic has the member
+    function asDynamic(exp: any, spacing?: Prettier): string {
+      const code = CPP(exp, spacing);
+      return TypeInference.isNative(types.typeOf(exp, scope)) ? `Dynamic(${code})` : code;
+    }
+
+    function createList(exp: Statement, spacing?: Prettier): string {
+      return `Dynamic::newList({${exp.value.map((item: any) => createDynamic(item, spacing)).join(", ")}})`;
+    }
+
+    function createMap(exp: Statement, spacing?: Prettier): string {
+      const entries = exp.value.map(({ key, value }: any) => `{${createDynamic(key, spacing)}, ${createDynamic(value, spacing)}}`);
+      return `Dynamic::newMap({${entries.join(", ")}})`;
+    }
+
+    // Packed arrays hand out elements by value, everything else by reference
+    function createIndex(exp: Statement, spacing?: Prettier): string {
+      const { target, index, dotOp } = exp.value;
+      const code = types.typeOf(target, scope) == Types.ARRAY
+        ? `${CPP(target, spacing)}.get(${CPP(index, spacing)})`
+        : `${asDynamic(target, spacing)}[${createDynamic(index, spacing)}]`;
+
+      return dotOp ? `${code}.${CPP(dotOp, new Prettier(2, 0))}` : code;
+    }
+
     function createAssign(exp: Expression, spacing?: Prettier): string {
-      if (variables.has(exp.left.value))
-        return `${exp.left.value} ${exp.op} ${CPP(exp.right)}`;
-      else
-        variables.set(exp.left.value, true);
+      // `list[i] = x` replaces an element, `map[key] = x` also adds missing keys
+      if (exp.left.type == "Index") {
+        const { target, index } = exp.left.value;
+        const isArray = types.typeOf(target, scope) == Types.ARRAY;
+        const container = isArray ? CPP(target, spacing) : asDynamic(target, spacing);
+
+        if (exp.op == "=")
+          return `${container}.set(${createDynamic(index, spacing)}, ${createDynamic(exp.right, spacing)})`;
+
+        if (isArray)
+          return `${container}.set(${CPP(index, spacing)}, ${createIndex(exp.left, spacing)} ${exp.op.replace("=", "")} ${CPP(exp.right, spacing)})`;
+
+        return `${createIndex(exp.left, spacing)} ${exp.op} ${CPP(exp.right, spacing)}`;
+      }
+
+      const key = `${scope}:${exp.left.value}`;
+      const op = exp.op.replace("=", "");
+      const type = types.variableType(scope, exp.left.value);
+
+      // A string literal stored in a Dynamic is the interned constant
+      const value = exp.op == "=" && type == Types.DYNAMIC ? createDynamic(exp.right, spacing) : CPP(exp.right, spacing);
+
+      if (variables.has(key)) {
+        if (type == Types.INT && checked[op] && types.typeOf(exp.right, scope) == Types.INT)
+          return `${exp.left.value} = ${checked[op]}(${exp.left.value}, ${value})`;
 
-      return `Dynamic ${exp.left.value} ${exp.op} ${CPP(exp.right, spacing)}`;
+        return `${exp.left.value} ${exp.op} ${value}`;
+      }
+
+      variables.set(key, true);
+
+      return `${type} ${exp.left.value} ${exp.op} ${value}`;
     }
 
+    // Emits one C++ overload per argument-type clone the program calls
     function createFunc(exp: Statement, spacing?: Prettier): string {
       const name = exp.value.name.value;
+      const parentScope = scope;
+
+      for (const [key, signature] of types.usedSignatures(name)) {
+        let prologue = "";
+        scope = key;
+
+        const parameters = exp.value.parameters.map((value: any, index: number) => {
+          const param = CPP(value, new Prettier(2, 0));
+          const type = types.variableType(key, value.value);
+
+          variables.set(`${key}:${value.value}`, true);
+
+          if (type == signature.args[index])
+            return `${type} ${param}`;
 
-      functions[name] = `Dynamic ${name}(${exp.value.parameters.length > 0
-          ? "Dynamic "
-          : ""}${exp.value.parameters.map((value: string, index: number, array: any[]) => CPP(array[index], new Prettier(2, 0))).join(", ")}) {\n${CPP(exp.value.scope, new Prettier(2, 0))}};`;
+          // Reassigned to another type in the body, so widen it on entry
+          prologue += `  ${type} ${param} = ${param}Arg;\n`;
+          return `${signature.args[index]} ${param}Arg`;
+        });
+
+        const prototype = `${signature.returns} ${name}(${parameters.join(", ")})`;
+
+        prototypes.push(prototype + ";");
+        // Inference made the return a Dynamic when the body can end without one
+        const epilogue = TypeInference.alwaysReturns(exp.value.scope.block) ? "" : "  return Dynamic();\n";
+
+        functions[key] = `${prototype} {\n${prologue}${CPP(exp.value.scope, new Prettier(2, 0))}${epilogue}};`;
+      }
+
+      scope = parentScope;
 
       return "";
     }
 
+    const unbox: { [type: string]: string[] } = {
+      [Types.INT]: ["INT", "num"],
+      [Types.DOUBLE]: ["DOUBLE", "flt"],
+      [Types.BOOL]: ["BOOL", "bln"]
+    };
+
+    // With type profiles (pgo builds) a probed build records which types the
+    // Dynamic variables passed to a function held. The next build calls the
+    // native clone behind a type check for those that always held one type.
     function createFuncCall(exp: Statement, spacing?: Prettier): string {
       const { name, args } = exp.value;
+      const signature = types.signatureOf(exp, scope);
+      const probed = probeTypes ? types.probeable(exp, scope) : [];
 
-      return `${name.value}(${args.map((value: string, index: number, array: any[]) => CPP(array[index], spacing)).join(", ")})${
+      const argCode = args.map((value: any, index: number) => {
+        let code = CPP(value, spacing);
+
+        if (probed.includes(index)) {
+          sites.push(TypeInference.site(scope, exp, index));
+          code = `TypeProfile::probe(SITE_${sites.length - 1}, ${code})`;
+        }
+
+        // Calls past the clone limit land on the all-Dynamic overload
+        return signature && types.typeOf(value, scope) != signature.args[index]
+          ? `Dynamic(${code})`
+          : code;
+      });
+
+      const call = `${name.value}(${argCode.join(", ")})${
         (exp.value.dotOp)
           ? "." + CPP(exp.value.dotOp, new Prettier(2, 0))
           : ""}`;
+
+      const guarded = exp.value.dotOp ? undefined : types.guardedTypes(exp, scope);
+      const clone = guarded && types.signatures.get(TypeInference.signatureKey(name.value, guarded));
+
+      // The clone limit can leave a call without its clone, and the two
+      // results have to meet in one type
+      if (!signature || !guarded || !clone || clone.args.join() != guarded.join()) return call;
+      if (clone.returns != signature.returns && signature.returns != Types.DYNAMIC) return call;
+
+      const checks: string[] = [];
+
+      const cloneArgs = args.map((value: any, index: number) => {
+        if (clone.args[index] == signature.args[index]) return argCode[index];
+
+        const [tag, member] = unbox[clone.args[index]];
+        const code = CPP(value, spacing);
+
+        checks.push(`${code}.type == Dynamic::${tag}`);
+        return `${code}.${member}`;
+      });
+
+      const fast = `${name.value}(${cloneArgs.join(", ")})`;
+
+      return `(${checks.join(" && ")} ? ${clone.returns == signature.returns ? fast : `Dynamic(${fast})`} : ${call})`;
     }
 
     function createReturn(exp: Statement, spacing?: Prettier): string {
@@ -152,7 +465,7 @@ export default class Transpiler {
     }
 
     function createSnippet(exp: Statement, spacing?: Prettier): string {
-      functions[`SNIPPET_${functions.length}`] = exp.value;
+      functions[`SNIPPET_${Object.keys(functions).length}`] = exp.value;
       return "";
     }
 
@@ -172,14 +485,6 @@ export default class Transpiler {
         case "Identifier":
           return createIdentifier(exp, spacing);
   
-        // case "Increment":
-        //   // TODO
-        //   break;
-  
-        // case "Decrement":
-        //   // TODO
-        //   break;
-  
         case "Function":
           return createFunc(exp, spacing);
   
@@ -206,9 +511,20 @@ export default class Transpiler {
         //   // TODO
         //   break;
   
-        // case "ForLoop":
-        //   // TODO
-        //   break;
+        case "ForLoop":
+          return createFor(exp, spacing);
+
+        case "WhileLoop":
+          return createWhile(exp, spacing);
+
+        case "List":
+          return createList(exp, spacing);
+
+        case "Map":
+          return createMap(exp, spacing);
+
+        case "Index":
+          return createIndex(exp, spacing);
         default: {
           // TODO
           return "";
@@ -217,10 +533,15 @@ export default class Transpiler {
     }
     
     let code = CPP(expr, spacing);
-    let functionCode = "";
+    let functionCode = [...literals].map(([literal, name]) => `const std::string ${name} = ${literal};\n`).join("")
+      + [...interned].map(([literal, name]) => `const Dynamic ${name} = Dynamic::intern(${literal});\n`).join("")
+      + sites.map((site, index) => `const size_t SITE_${index} = TypeProfile::site(${JSON.stringify(site)});\n`).join("");
+
+    if (literals.size + interned.size + sites.length > 0) functionCode += "\n";
+    if (prototypes.length > 0) functionCode += prototypes.join("\n") + "\n\n";
 
     for (const name in functions) {
-      functionCode = functions[name];
+      functionCode += functions[name] + "\n\n";
     }
 
     functionCode += "\n\n" + code;
@@ -3,6 +3,10 @@ export interface Token {
 	value: any;
 	index: number;
 	line: number;
+
+	// Offsets of the token in the source
+	start?: number;
+	end?: number;
 };
 
 export interface LexerGrammar {
@@ -26,4 +30,10 @@ export interface LexerGrammar {
 
 export interface Precedence {
 	[x: string]: number
+};
+
+// A runtime built once, see mods/runtime.ts
+export interface Runtime {
+	header: string;
+	library: string;
 };
\ No newline at end of file
@@ -0,0 +1,44 @@
+// Allocations per concatenation in a Dynamic string-building loop, the
+// code ADK emits for `s = s + word + ", "`. Counts every operator new.
+//   g++ -std=c++17 -O2 tests/concat.cpp -o concat && ./concat
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../src/builtIns/langCPP.cpp"
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+
+  if (void* memory = std::malloc(size ? size : 1))
+    return memory;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+  std::free(memory);
+}
+
+int main() {
+  const int ITERATIONS = 10000;
+  const std::string SEPARATOR = ", ";
+
+  // Longer than a small string, so it's kept on the heap like most words
+  Dynamic word = std::string("customer record");
+  Dynamic built = std::string("");
+
+  size_t before = allocations;
+
+  for (int i = 0; i < ITERATIONS; i++)
+    built = built + word + SEPARATOR;
+
+  printf("%.1f allocations per concatenation\n", (double)(allocations - before) / ITERATIONS);
+  printf("%zu characters built\n", built.getString().size());
+}
@@ -0,0 +1,19 @@
+// Runs tests/files.adk, which reads through one handle what another one
+// appended. `deno test -A tests/`
+const decode = TextDecoder.prototype.decode.bind(new TextDecoder);
+
+Deno.test("tests/files.adk reads appends through a second handle", async () => {
+  const { success, stdout, stderr } = await new Deno.Command(Deno.execPath(), {
+    args: ["run", "-A", "index.ts", "run", "tests/files.adk", "--no-cache"],
+    stdout: "piped",
+    stderr: "piped"
+  }).output();
+
+  await Deno.remove("files.txt").catch(() => {});
+
+  if (!success) throw new Error(`tests/files.adk failed:\n${decode(stderr)}`);
+
+  const expected = "hello\nhelloworld \n";
+  if (decode(stdout) != expected)
+    throw new Error(`Expected:\n${expected}\nGot:\n${decode(stdout)}`);
+});
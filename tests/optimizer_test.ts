@@ -0,0 +1,23 @@
+// Runs tests/*.adk programs with and without the optimizer, which must
+// never change what a program prints. `deno test -A tests/`
+const decode = TextDecoder.prototype.decode.bind(new TextDecoder);
+
+async function run(file: string, flags: string[] = []): Promise<string> {
+  const { success, stdout, stderr } = await new Deno.Command(Deno.execPath(), {
+    args: ["run", "-A", "index.ts", "run", file, "--no-cache", ...flags],
+    stdout: "piped",
+    stderr: "piped"
+  }).output();
+
+  if (!success) throw new Error(`${file} failed:\n${decode(stderr)}`);
+  return decode(stdout);
+}
+
+for (const file of ["tests/optimizer.adk"]) {
+  Deno.test(`${file} prints the same optimized`, async () => {
+    const [optimized, plain] = await Promise.all([run(file), run(file, ["--no-optimize"])]);
+
+    if (optimized != plain)
+      throw new Error(`Optimized:\n${optimized}\nUnoptimized:\n${plain}`);
+  });
+}